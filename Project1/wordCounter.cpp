@@ -3,163 +3,29 @@
 #include <iostream>
 #include <mutex>
 #include <fstream>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+#include <unordered_set>
+#include <cmath>
+#include <climits>
+#include <cstdlib>
+#include "../Project2/BasicHashMap.h"
+#include "../Project2/WordCount.h"
+#include "../Project2/Affinity.h"
+#include "../Project2/TuningStore.h"
 
 using namespace std;
 
-class HashNode {
-public:
-    string key;
-    long value;
-    HashNode* next;
-
-    //rather than making a copy of a copy, move the copy to the parameter to reduce memory usage
-    HashNode(string key, long value) : key(std::move(key)), value(value), next(nullptr) {}
-};
-int collisions = 0;
-class HashMap {
-private:
-    long currentSize = 0;
-    int segmentSize = 1000;
-    int mutexCount;
-
-public:
-    HashNode** table;
-    int tableSize;
-    std::mutex* bucketMutexes;
-
-    explicit HashMap(int size) {
-        tableSize = size;
-        table = new HashNode * [tableSize];
-        mutexCount = (tableSize + segmentSize - 1) / segmentSize; // Ceiling division
-        bucketMutexes = new std::mutex[mutexCount];  // Allocate array of mutexes
-
-
-        //initialize all fields to null
-        fill(table, table + tableSize, nullptr);
-    }
-    // Destructor to prevent memory leaks
-    ~HashMap() {
-        for (int i = 0; i < tableSize; ++i) {
-            HashNode* node = table[i];
-            while (node != nullptr) {
-                HashNode* temp = node;
-                node = node->next;
-                //free(temp);
-                delete(temp);
-            }
-        }
-        delete[] table;
-        delete[] bucketMutexes;
-    }
-
-    //FNV-1a Hash Function
-    unsigned long hashFunction(const string& key) const {
-        const unsigned long fnv_prime = 0x811C9DC5;
-        unsigned long hash = 0;
-        for (char c : key) {
-            hash ^= c;
-            hash *= fnv_prime;
-        }
-        return hash % tableSize;
-    }
-
-    size_t getSegmentIndex(size_t bucketIndex) const {
-        return bucketIndex / segmentSize;
-    }
-
-    void insert(const string& key) const {
-        if (key.empty()) return; // Early exit if the key is empty
-
-        int index = hashFunction(key);
-
-        // Directly access this HashMap's table
-        HashNode** slot = &table[index];
-        int i = 0;
-        for (HashNode* currentNode = *slot; currentNode; currentNode = currentNode->next) {
-            i++;
-            if (i > 1) {
-                //cout << "there was a collision!";
-                collisions++;
-            }
-            if (currentNode->key == key) {
-                currentNode->value++; // Since it's thread-specific, no need for atomic
-                return;
-            }
-        }
-
-        // Node not found, create a new node and link it
-        HashNode* newNode = new HashNode(key, 1);
-        newNode->next = *slot;
-        *slot = newNode;
-
-        // Increase the size. This is safe since the HashMap is thread-specific.
-        currentSize++;
-    }
-
-    void insertWords(const std::string& words) {
-        size_t start = 0;
-        size_t end = words.find(' ');
-        int index;
-
-        while (end != std::string::npos) {
-            std::string word = words.substr(start, end - start);
-            this->insert(word);
-
-            // Update start and end for the next word
-            start = end + 1;
-            end = words.find(' ', start);
-        }
-
-        // Insert the last word (or the only word if there are no spaces)
-        std::string lastWord = words.substr(start);
-        this->insert(lastWord);
-    }
-
-
-    long get(const string& key) {
-
-        // Compute the hash code and find the corresponding bucket index
-        int index = hashFunction(key) % tableSize;
+// Word counts: occurrences summed per word, in the same table Project2 counts with
+using HashMap = BasicHashMap<string, long>;
+using HashNode = HashMap::Node;
 
-        // Search for the key in the linked list at the computed index
-        HashNode* node = table[index];
-        while (node) {
-            if (node->key.compare(key) == 0) {
-                return node->value;  // Key found, return value
-            }
-            node = node->next;
-        }
-        // Key not found, return a default value
-        return -1;
-    }
-
-};
-
-class WordCount {
-public:
-    string word;
-    long count;
-
-    WordCount() : word(""), count(0) {}
-    explicit WordCount(std::string  w, int c) : word(std::move(w)), count(c) {}
-
-};
-
-
-string normalizeWord(const string& word) {
-    string normalized;
-    for (char ch : word) {
-        if(ch >= 0)
-            if (isalpha(ch) || ch == '-') {
-                normalized += tolower(ch);
-            }
-    }
-    return normalized;
-}
-
-int countWords(HashNode** table, int tableSize) {
+int countWords(HashNode** table, unsigned long tableSize) {
     int count = 0;
-    for (int i = 0; i < tableSize; ++i) {
+    for (unsigned long i = 0; i < tableSize; ++i) {
         for (HashNode* node = table[i]; node != nullptr; node = node->next) {
             ++count;
         }
@@ -167,56 +33,24 @@ int countWords(HashNode** table, int tableSize) {
     return count;
 }
 
-void merge(WordCount** arr, int low, int mid, int high) {
-    int n1 = mid - low + 1;
-    int n2 = high - mid;
-
-    WordCount** L = new WordCount * [n1];
-    WordCount** R = new WordCount * [n2];
-
-    for (int i = 0; i < n1; ++i) {
-        L[i] = arr[low + i];
-    }
-    for (int j = 0; j < n2; ++j) {
-        R[j] = arr[mid + 1 + j];
-    }
-
-    int i = 0, j = 0, k = low;
-    while (i < n1 && j < n2) {
-        if (L[i]->count >= R[j]->count) {
-            arr[k++] = L[i++];
-        }
-        else {
-            arr[k++] = R[j++];
+//words that share a bucket with another word: every node after the first of its chain
+int countCollisions(HashNode** table, unsigned long tableSize) {
+    int count = 0;
+    for (unsigned long i = 0; i < tableSize; ++i) {
+        if (table[i] != nullptr) {
+            count += countWords(&table[i], 1) - 1;
         }
     }
-
-    while (i < n1) {
-        arr[k++] = L[i++];
-    }
-    while (j < n2) {
-        arr[k++] = R[j++];
-    }
-
-    delete[] L;
-    delete[] R;
+    return count;
 }
 
-void mergeSort(WordCount** arr, int low, int high) {
-    if (low < high) {
-        int mid = low + (high - low) / 2;
-        mergeSort(arr, low, mid);
-        mergeSort(arr, mid + 1, high);
-        merge(arr, low, mid, high);
-    }
-}
 void outputHashMap(HashMap& hashMap, const string& filename) {
     int totalWords = countWords(hashMap.table, hashMap.tableSize);
     WordCount** wordCounts = new WordCount * [totalWords];
 
     int index = 0;
 
-    for (int i = 0; i < hashMap.tableSize; ++i) {
+    for (unsigned long i = 0; i < hashMap.tableSize; ++i) {
         HashNode* node = hashMap.table[i];
         while (node != nullptr) {
             wordCounts[index++] = new WordCount(node->key, node->value);
@@ -256,62 +90,57 @@ long getFileLength(ifstream& file) {
     return length; // Return the length of the file
 }
 
+//Estimates the distinct words in the file from its first megabyte instead of guessing a word
+//length and a unique share. The distinct count of the first half of the sample against the whole
+//sample gives the growth exponent (Heaps' law, V = K * n^beta) used to extrapolate to the file
 int estimateHashMapSize(ifstream& file) {
     long fileSize = getFileLength(file);
     if (fileSize == -1) return -1; // File open error
 
-    const int averageWordSize = 5; // Average word size in characters (a rough guess)
-    long totalWords = fileSize / averageWordSize; // Estimate total words
-    double uniqueFactor = 0.2; // Assume 20% of words are unique, adjust based on expected data
-    int hashMapSize = static_cast<int>(totalWords * uniqueFactor);
+    const long sampleBytes = 1024 * 1024;
+    std::streampos currentPos = file.tellg();
+    file.seekg(0);
+    unordered_set<string> distinct;
+    unsigned long halfDistinct = 0;
+    long sampleRead = 0;
+    string word;
+    while (file >> word) {
+        sampleRead = file.tellg();
+        string normalized = normalizeWord(word);
+        if (!normalized.empty()) distinct.insert(normalized);
+        if (halfDistinct == 0 && sampleRead >= sampleBytes / 2) halfDistinct = distinct.size();
+        if (sampleRead >= sampleBytes) break;
+    }
+    file.clear();
+    file.seekg(currentPos); // Restore the file pointer to its original position
+    if (distinct.empty() || sampleRead <= 0) return 100;
+
+    double beta = 1.0;
+    if (halfDistinct > 0 && sampleRead < fileSize) {
+        beta = min(1.0, max(0.3, log2((double)distinct.size() / halfDistinct)));
+    }
+    double hashMapSize = distinct.size() * pow((double)fileSize / sampleRead, beta);
+    hashMapSize = min(hashMapSize, (double)INT_MAX / 2);
 
-    return hashMapSize > 100 ? hashMapSize : 100; // Ensure a minimum size for the HashMap
+    return hashMapSize > 100 ? (int)hashMapSize : 100; // Ensure a minimum size for the HashMap
 }
 
 void mergeResults(HashMap& mainTable, const HashMap& threadTable) {
-    for (int i = 0; i < threadTable.tableSize; ++i) {
-        HashNode* threadNode = threadTable.table[i];
-        while (threadNode != nullptr) {
-            // Lock the bucket for thread safety
-            std::lock_guard<std::mutex> lock(mainTable.bucketMutexes[mainTable.getSegmentIndex(mainTable.hashFunction(threadNode->key))]);
-
-            // Insert or update the node in the main table
-            HashNode** mainNodePtr = &mainTable.table[mainTable.hashFunction(threadNode->key)];
-            while (*mainNodePtr != nullptr && (*mainNodePtr)->key != threadNode->key) {
-                mainNodePtr = &((*mainNodePtr)->next);
-            }
-
-            if (*mainNodePtr == nullptr) {
-                // Key not found in the main table, insert a new node
-                *mainNodePtr = new HashNode(threadNode->key, threadNode->value);
-            }
-            else {
-                // Key found, update the value
-                (*mainNodePtr)->value += threadNode->value;
-            }
-
-            // Move to the next node in the thread-specific table
-            threadNode = threadNode->next;
-        }
-    }
+    mainTable.mergeFrom(threadTable);
 }
 
-void dispatchThreads(int numThreads, const string& fileName, HashMap& mainTable) {
-    thread* threads = new thread[numThreads];
-    HashMap** threadTables = new HashMap * [numThreads]; // Array of pointers to HashMaps
+//splits the file into `chunks` ranges [start, end] that end on a space, the way each thread's chunk always has
+vector<pair<long, long>> splitRanges(const string& fileName, int chunks) {
+    vector<pair<long, long>> ranges;
     ifstream file(fileName);
-    if (!file.is_open()) {
-        cerr << "Failed to open file: " << fileName << endl;
-        return;
-    }
     long length = getFileLength(file);
-    long chunkSize = length / numThreads;
+    long chunkSize = length / chunks;
     long startPos = 0;
     long endPos = 0;
 
-    for (int i = 0; i < numThreads; i++) {
+    for (int i = 0; i < chunks; i++) {
         startPos = endPos; // Start from the previous end position
-        if (i < numThreads - 1) {
+        if (i < chunks - 1) {
             endPos = startPos + chunkSize;
             file.seekg(endPos); // Move to the end position of the current chunk
             char c;
@@ -319,63 +148,283 @@ void dispatchThreads(int numThreads, const string& fileName, HashMap& mainTable)
             while (file.get(c) && c != ' ' && endPos < length) {
                 ++endPos;
             }
+            file.clear();
         }
         else {
             endPos = length; // Last chunk goes to the end of the file
         }
-
-        // Each thread gets its own copy of endPos to avoid overlap
-        long threadEndPos = endPos;
-        threadTables[i] = new HashMap(estimateHashMapSize(file));
-
-        threads[i] = thread([startPos, threadEndPos, &fileName, threadTable = threadTables[i]]() {
-            ifstream threadFile(fileName);
-            threadFile.seekg(startPos);
-            string segment;
-            string word;
-            // Read until the designated end position for the thread
-            while (threadFile.tellg() < threadEndPos && threadFile >> word) {
-                if (!segment.empty()) segment += " ";
-                segment += normalizeWord(word);
-            }
-            threadTable->insertWords(segment);
-        });
+        ranges.emplace_back(startPos, endPos);
 
         // Prepare for the next chunk
         endPos++;
     }
+    return ranges;
+}
+
+//counts the words of one range into `table`
+void countRange(const string& fileName, long startPos, long endPos, HashMap& table) {
+    ifstream threadFile(fileName);
+    threadFile.seekg(startPos);
+    string segment;
+    string word;
+    // Read until the designated end position for the thread
+    while (threadFile.tellg() < endPos && threadFile >> word) {
+        if (!segment.empty()) segment += " ";
+        segment += normalizeWord(word);
+    }
+    table.insertWords(segment);
+}
+
+// Results of one submitted file: every range task merges into `result`,
+// and wait() returns once the last one has
+class CountJob {
+public:
+    HashMap& result;
+    int pending;   // tasks not yet finished, guarded by lock
+    mutex lock;
+    condition_variable done;
+
+    explicit CountJob(HashMap& result) : result(result), pending(0) {}
+
+    void addTask() {
+        lock_guard<mutex> guard(lock);
+        pending++;
+    }
+
+    void wait() {
+        unique_lock<mutex> guard(lock);
+        done.wait(guard, [this]() { return pending == 0; });
+    }
+
+    //decrements and notifies under the lock: once wait() can see 0 the job may be
+    //destroyed, so nothing may touch it after the lock is released
+    void finishTask() {
+        lock_guard<mutex> guard(lock);
+        if (--pending == 0) {
+            done.notify_all();
+        }
+    }
+};
 
-    // Wait for all threads to complete
-    for (int i = 0; i < numThreads; ++i) {
-        threads[i].join();
+/**
+ * Threads started once and reused for every file.
+ * Each worker has its own task deque and its own scratch table. A task counts a file
+ * range into the scratch table, merges that into its job's result and clears the
+ * table, which keeps its buckets and nodes for the next task.
+ * Steps for a worker:
+ * 1. take the newest task from its own deque
+ * 2. if that is empty, steal the oldest task from another worker's deque
+ * 3. if every deque is empty, sleep until a task is submitted
+ */
+class ThreadPool {
+public:
+    ThreadPool(int numThreads, int tableSize, unsigned long chunkBytes)
+        : chunkBytes(chunkBytes), stopping(false), queued(0), nextWorker(0) {
+        for (int i = 0; i < numThreads; i++) {
+            workers.push_back(new Worker());
+        }
+        for (int i = 0; i < numThreads; i++) {
+            workers[i]->runner = thread([this, i, numThreads, tableSize]() {
+                // Pin first, then allocate, so the table's pages land on this thread's NUMA node
+                pinWorker(i, numThreads);
+                workers[i]->table = new HashMap(tableSize);
+                run(i);
+            });
+        }
     }
 
-    // Merge thread results into the main table
-    for (int i = 0; i < numThreads; ++i) {
-        mergeResults(mainTable, *threadTables[i]);
-        delete threadTables[i]; // Clean up
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> guard(sleepLock);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for (Worker* worker : workers) {
+            worker->runner.join();
+            delete worker->table;
+            delete worker;
+        }
     }
 
-    delete[] threads;
-    delete[] threadTables;
+    int size() const {
+        return (int)workers.size();
+    }
+
+    void submitRange(CountJob& job, const string& fileName, long startPos, long endPos) {
+        job.addTask();
+        Worker* worker = workers[nextWorker++ % workers.size()];
+        {
+            lock_guard<mutex> guard(worker->lock);
+            worker->tasks.push_back([&job, fileName, startPos, endPos](HashMap& table) {
+                countRange(fileName, startPos, endPos, table);
+                mergeResults(job.result, table);
+                table.clear();
+                job.finishTask();
+            });
+        }
+        {
+            lock_guard<mutex> guard(sleepLock);
+            queued++;
+        }
+        wakeUp.notify_one();
+    }
+
+    //one range per worker (or per chunkBytes, if tuned), or a single range for a small file
+    void submitFile(CountJob& job, const string& fileName) {
+        ifstream file(fileName);
+        long length = getFileLength(file);
+        int chunks = (int)max(1L, min((long)workers.size(), length / MIN_TASK_BYTES));
+        if (chunkBytes > 0 && length > 0) {
+            chunks = max(chunks, (int)min((long)INT_MAX, (long)((length + chunkBytes - 1) / chunkBytes)));
+        }
+        for (const pair<long, long>& range : splitRanges(fileName, chunks)) {
+            submitRange(job, fileName, range.first, range.second);
+        }
+    }
+
+private:
+    static const long MIN_TASK_BYTES = 64 * 1024; // smaller files aren't worth splitting
+
+    struct Worker {
+        deque<function<void(HashMap&)>> tasks;
+        mutex lock;
+        HashMap* table = nullptr;
+        thread runner;
+    };
+
+    vector<Worker*> workers;
+    unsigned long chunkBytes;
+    mutex sleepLock;
+    condition_variable wakeUp;
+    bool stopping;
+    long queued; // tasks in all deques, guarded by sleepLock
+    atomic<unsigned long> nextWorker;
+
+    bool takeTask(int self, function<void(HashMap&)>& task) {
+        {
+            lock_guard<mutex> guard(workers[self]->lock);
+            if (!workers[self]->tasks.empty()) {
+                task = std::move(workers[self]->tasks.back());
+                workers[self]->tasks.pop_back();
+                return true;
+            }
+        }
+        for (unsigned long k = 1; k < workers.size(); k++) {
+            Worker* victim = workers[(self + k) % workers.size()];
+            lock_guard<mutex> guard(victim->lock);
+            if (!victim->tasks.empty()) {
+                task = std::move(victim->tasks.front());
+                victim->tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(int self) {
+        function<void(HashMap&)> task;
+        while (true) {
+            {
+                unique_lock<mutex> guard(sleepLock);
+                wakeUp.wait(guard, [this]() { return stopping || queued > 0; });
+                if (queued == 0) {
+                    return; // stopping, and nothing left to do
+                }
+                queued--; // claims one task; it is in some deque
+            }
+            while (!takeTask(self, task)) {
+                this_thread::yield(); // claimed but not yet pushed where we looked; look again
+            }
+            task(*workers[self]->table);
+        }
+    }
+};
+
+//counts one file on the pool into mainTable
+void dispatchThreads(ThreadPool& pool, const string& fileName, HashMap& mainTable) {
+    CountJob job(mainTable);
+    pool.submitFile(job, fileName);
+    job.wait();
 }
 
-int main() {
+int main(int argc, char* argv[]) {
     int numThreads = 8;
-    string fileName = "Bible.txt";
-    ifstream inputFile(fileName);
-    cout << "File Name: " << fileName << endl;
+    int requestedThreads = 0;
+    bool useTuning = true;
+    bool pin = false;
+    string tuningPath = defaultTuningPath();
+    vector<string> fileNames;
+    //Every other argument is an input file (default Bible.txt); the threads are started once for all of them
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            requestedThreads = max(1, atoi(argv[++i]));
+        } else if (arg == "--no-tune") {
+            useTuning = false;
+        } else if (arg == "--pin") {
+            pin = true;
+        } else if (arg == "--tuning-file" && i + 1 < argc) {
+            tuningPath = argv[++i];
+        } else {
+            fileNames.push_back(arg);
+        }
+    }
+    if (fileNames.empty()) {
+        fileNames.push_back("Bible.txt");
+    }
+    string largestFile;
+    long largestLength = -1;
+    for (const string& name : fileNames) {
+        ifstream file(name);
+        if (!file) {
+            cerr << "Error opening input file " << name << "." << endl;
+            return 1;
+        }
+        long length = getFileLength(file);
+        if (length > largestLength) {
+            largestLength = length;
+            largestFile = name;
+        }
+    }
+
+    // Settings Project2's --autotune measured for this machine, for the kind of corpus the
+    // largest file is; the pool is shared, so one setting serves every file
+    TuningConfig tuning;
+    tuning.threads = numThreads;
+    if (useTuning) {
+        string corpus = corpusClass(largestFile);
+        if (loadTuning(tuningPath, hostKey(), corpus, tuning)) {
+            cout << "Using tuned settings for " << corpus << " from " << tuningPath << endl;
+            numThreads = tuning.threads;
+        }
+    }
+    if (requestedThreads > 0) {
+        numThreads = requestedThreads;
+    }
     cout << "Using " << numThreads << ((numThreads > 1 ) ? " threads" : " thread") << endl;
-    if (!inputFile) {
-        cerr << "Error opening input file." << endl;
-        return 1;
+    configureAffinity(pin); // --pin: workers are pinned node by node, as in Project2
+
+    // Scratch tables are sized for the largest file, since they are reused for all of them
+    int threadTableSize = 100;
+    for (const string& name : fileNames) {
+        ifstream inputFile(name);
+        threadTableSize = max(threadTableSize, (int)(estimateHashMapSize(inputFile) * tuning.tableScale));
+    }
+    ThreadPool pool(numThreads, threadTableSize, tuning.chunkBytes);
+    int collisions = 0;
+
+    for (unsigned long k = 0; k < fileNames.size(); k++) {
+        ifstream inputFile(fileNames[k]);
+        cout << "File Name: " << fileNames[k] << endl;
+        int hashMapSize = max(100, (int)(estimateHashMapSize(inputFile) * tuning.tableScale));
+        //cout << "HashMap size: " << hashMapSize << endl;
+        HashMap wordCount(hashMapSize); // Start with an initial size
+        dispatchThreads(pool, fileNames[k], wordCount);
+        collisions += countCollisions(wordCount.table, wordCount.tableSize);
+        string outputName = fileNames.size() == 1 ? "output.txt" : "output_" + to_string(k + 1) + ".txt";
+        outputHashMap(wordCount, outputName);
     }
-    int hashMapSize = estimateHashMapSize(inputFile);
-    //cout << "HashMap size: " << hashMapSize << endl;
-    HashMap wordCount(hashMapSize); // Start with an initial size
-    dispatchThreads(numThreads, fileName, wordCount);
     cout << "There were " << collisions << " collisions!" << endl;
-    outputHashMap(wordCount, "output.txt");
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,163 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+#include <dirent.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sched.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#endif
+#include "Affinity.h"
+
+using namespace std;
+
+static NumaTopology topology;
+static bool pinning = false;
+
+//parses a sysfs cpulist such as "0-3,8-11"
+static vector<int> parseCpuList(const string& list) {
+    vector<int> cpus;
+    stringstream ranges(list);
+    string range;
+    while (getline(ranges, range, ',')) {
+        if (range.empty() || range == "\n") continue;
+        unsigned long dash = range.find('-');
+        int first = stoi(range.substr(0, dash));
+        int last = dash == string::npos ? first : stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+NumaTopology detectTopology() {
+    NumaTopology result;
+    DIR* nodes = opendir("/sys/devices/system/node");
+    if (nodes != nullptr) {
+        vector<pair<int, vector<int>>> found;
+        while (dirent* entry = readdir(nodes)) {
+            string name = entry->d_name;
+            if (name.compare(0, 4, "node") != 0 || name.size() == 4 || !isdigit((unsigned char)name[4])) continue;
+            ifstream cpuList("/sys/devices/system/node/" + name + "/cpulist");
+            string list;
+            getline(cpuList, list);
+            vector<int> cpus = parseCpuList(list);
+            if (!cpus.empty()) {
+                found.emplace_back(stoi(name.substr(4)), cpus);
+            }
+        }
+        closedir(nodes);
+        sort(found.begin(), found.end());
+        for (auto& node : found) {
+            result.nodeCpus.push_back(node.second);
+        }
+    }
+    if (result.nodeCpus.empty()) {
+        vector<int> cpus;
+        for (unsigned int cpu = 0; cpu < max(1u, thread::hardware_concurrency()); cpu++) {
+            cpus.push_back(cpu);
+        }
+        result.nodeCpus.push_back(cpus);
+    }
+    return result;
+}
+
+//turns pinning on for every later dispatch; call once from main before counting
+void configureAffinity(bool enabled) {
+    pinning = enabled;
+    if (enabled) {
+        topology = detectTopology();
+        cout << "Pinning threads over " << topology.nodeCpus.size() << " NUMA node"
+             << (topology.nodeCpus.size() > 1 ? "s" : "") << endl;
+    }
+}
+
+bool affinityEnabled() {
+    return pinning;
+}
+
+const NumaTopology& activeTopology() {
+    return topology;
+}
+
+//threads go to nodes in contiguous blocks, so each node gets one contiguous stretch of the file
+int nodeForThread(int threadNum, int numThreads) {
+    int nodes = (int)topology.nodeCpus.size();
+    return (int)((long)threadNum * nodes / numThreads);
+}
+
+/**
+ * Pins the calling thread to one CPU of its node.
+ * Call at the top of a parallel region, before the thread allocates anything:
+ * Linux places a page on the node of the thread that first touches it, so the
+ * thread's table and the nodes it allocates then stay on its own socket.
+ */
+void pinWorker(int threadNum, int numThreads) {
+    if (!pinning) {
+        return;
+    }
+#ifdef __linux__
+    int node = nodeForThread(threadNum, numThreads);
+    const vector<int>& cpus = topology.nodeCpus[node];
+    int firstOnNode = (int)(((long)node * numThreads + topology.nodeCpus.size() - 1) / topology.nodeCpus.size());
+    int cpu = cpus[(threadNum - firstOnNode) % cpus.size()];
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+//spreads the pages of a shared array round-robin over the nodes, moving any already touched
+void interleaveAcrossNodes(void* address, unsigned long bytes) {
+    if (!pinning || topology.nodeCpus.size() < 2 || bytes == 0) {
+        return;
+    }
+#ifdef __linux__
+    const int MPOL_INTERLEAVE_MODE = 3;
+    const unsigned long MPOL_MF_MOVE_FLAG = 1 << 1;
+    unsigned long pageSize = sysconf(_SC_PAGESIZE);
+    unsigned long start = (unsigned long)address & ~(pageSize - 1);
+    unsigned long end = ((unsigned long)address + bytes + pageSize - 1) & ~(pageSize - 1);
+
+    unsigned long nodeMask = 0;
+    for (unsigned long node = 0; node < topology.nodeCpus.size() && node < 64; node++) {
+        nodeMask |= 1UL << node;
+    }
+    if (syscall(SYS_mbind, start, end - start, MPOL_INTERLEAVE_MODE, &nodeMask, 64, MPOL_MF_MOVE_FLAG) != 0) {
+        cerr << "Could not interleave the main table across nodes" << endl;
+    }
+#endif
+}
+
+NumaCounters readNumaCounters() {
+    NumaCounters counters;
+    for (unsigned long node = 0; node < 1024; node++) {
+        ifstream stats("/sys/devices/system/node/node" + to_string(node) + "/numastat");
+        if (!stats) {
+            if (node >= topology.nodeCpus.size()) break;
+            continue;
+        }
+        string name;
+        uint64_t value;
+        while (stats >> name >> value) {
+            if (name == "local_node") counters.localNode += value;
+            if (name == "other_node") counters.otherNode += value;
+        }
+    }
+    return counters;
+}
+
+//one line per phase: time, throughput, and how many pages went to a remote node meanwhile
+void reportPhase(const string& name, double seconds, unsigned long bytes,
+                 const NumaCounters& before, const NumaCounters& after) {
+    double megabytes = bytes / (1024.0 * 1024.0);
+    cout << "Phase " << name << ": " << seconds * 1000 << " ms, " << megabytes << " MiB, "
+         << (seconds > 0 ? megabytes / seconds : 0) << " MiB/s, pages local "
+         << after.localNode - before.localNode << ", remote " << after.otherNode - before.otherNode << endl;
+}
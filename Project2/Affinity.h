@@ -0,0 +1,31 @@
+#ifndef PARALLELPROCESSING_AFFINITY_H
+#define PARALLELPROCESSING_AFFINITY_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// CPUs of every NUMA node that has any, read from /sys/devices/system/node.
+// Elsewhere (or without sysfs) it is one node holding every CPU.
+struct NumaTopology {
+    std::vector<std::vector<int>> nodeCpus;
+};
+
+// Pages placed per node, summed over all nodes (from each node's numastat)
+struct NumaCounters {
+    uint64_t localNode = 0;   // allocated on the node of the CPU that asked
+    uint64_t otherNode = 0;   // allocated on another node than the one asking
+};
+
+NumaTopology detectTopology();
+void configureAffinity(bool enabled);
+bool affinityEnabled();
+const NumaTopology& activeTopology();
+int nodeForThread(int threadNum, int numThreads);
+void pinWorker(int threadNum, int numThreads);
+void interleaveAcrossNodes(void* address, unsigned long bytes);
+NumaCounters readNumaCounters();
+void reportPhase(const std::string& name, double seconds, unsigned long bytes,
+                 const NumaCounters& before, const NumaCounters& after);
+
+#endif //PARALLELPROCESSING_AFFINITY_H
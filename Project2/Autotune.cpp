@@ -0,0 +1,152 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <omp.h>
+#include "Autotune.h"
+#include "Utils.h"
+
+using namespace std;
+
+TuningConfig activeTuning;
+
+/**
+ * Writes AUTOTUNE_SAMPLE_RANGES evenly spaced ranges of the file, `bytes` in all and
+ * cut at whitespace, into one sample file in `dir` named with `tag`, so calibration
+ * sees text from the whole corpus and not only its start. A file no bigger than the
+ * sample is used as it is.
+ */
+string writeSample(const string& fileName, const string& dir, unsigned long bytes, const string& tag) {
+    ifstream file(fileName, ios::binary);
+    unsigned long length = getFileLength(file);
+    if (length <= bytes) {
+        return fileName;
+    }
+    string sampleName = dir + "/wordcount-" + tag + "-" + to_string(getpid()) + ".txt";
+    ofstream sample(sampleName, ios::binary);
+    unsigned long rangeBytes = bytes / AUTOTUNE_SAMPLE_RANGES;
+    string range(rangeBytes, '\0');
+    for (unsigned long r = 0; r < AUTOTUNE_SAMPLE_RANGES; r++) {
+        file.clear();
+        file.seekg(length / AUTOTUNE_SAMPLE_RANGES * r);
+        file.read(&range[0], rangeBytes);
+        unsigned long read = file.gcount();
+        unsigned long first = 0;
+        while (first < read && !isspace((unsigned char)range[first])) first++;
+        unsigned long last = read;
+        while (last > first && !isspace((unsigned char)range[last - 1])) last--;
+        sample.write(range.data() + first, last - first);
+        sample << "\n";
+    }
+    return sampleName;
+}
+
+//sample MB counted per second with `config`, best of AUTOTUNE_REPEATS; table sizing and allocation included
+double measureThroughput(const string& sampleName, const TuningConfig& config) {
+    TuningConfig saved = activeTuning;
+    activeTuning = config;
+    ifstream sample(sampleName);
+    double megabytes = getFileLength(sample) / (1024.0 * 1024.0);
+    double best = 0;
+    for (int repeat = 0; repeat < AUTOTUNE_REPEATS; repeat++) {
+        double start = omp_get_wtime();
+        unsigned long mainTableSize = 0;
+        unsigned long threadTableSize = 0;
+        estimateTableSizes(sampleName, config.threads, mainTableSize, threadTableSize);
+        HashMap table(mainTableSize);
+        dispatchThreads(config.threads, sampleName, table, threadTableSize);
+        best = max(best, megabytes / max(1e-6, omp_get_wtime() - start));
+    }
+    activeTuning = saved;
+    return best;
+}
+
+/**
+ * Finds the fastest settings for this machine on a sample of the file.
+ * Steps, each keeping the best of the one before:
+ * 1. thread count: powers of two up to twice the hardware threads, the hardware
+ *    thread count itself and the old default
+ * 2. chunk size: one chunk per thread, or 16 MB to 256 KB chunks taken in turn, on a
+ *    sample of up to AUTOTUNE_CHUNK_SAMPLE_BYTES. A size is only tried when the sample
+ *    holds AUTOTUNE_CHUNKS_PER_THREAD chunks per thread, since with fewer the chunks
+ *    can't balance anything and the run says nothing about the full file
+ * 3. table size: the estimate times 0.25 to 2
+ * The best setting so far is measured again whenever the sample changes, so every
+ * comparison is on the same text. Tuning one setting at a time takes about 15 runs
+ * where the full grid would take 150.
+ */
+TuningConfig autotune(const string& fileName, const string& dir, int defaultThreads) {
+    string sampleName = writeSample(fileName, dir, AUTOTUNE_SAMPLE_BYTES, "sample");
+    cout << "Calibrating on " << sampleName << endl;
+
+    auto describe = [](const TuningConfig& config) {
+        ostringstream text;
+        text << config.threads << " threads, "
+             << (config.chunkBytes == 0 ? string("one chunk per thread") : to_string(config.chunkBytes / 1024) + " KB chunks")
+             << ", tables x" << config.tableScale;
+        return text.str();
+    };
+    TuningConfig best;
+    best.threads = defaultThreads;
+    auto tryConfig = [&](const string& sample, const TuningConfig& candidate) {
+        double throughput = measureThroughput(sample, candidate);
+        cout << "  " << describe(candidate) << ": " << (unsigned long)throughput << " MB/s" << endl;
+        if (throughput > best.throughput) {
+            best = candidate;
+            best.throughput = throughput;
+        }
+    };
+
+    int hardware = max(1, (int)thread::hardware_concurrency());
+    vector<int> threadCounts = {hardware, defaultThreads};
+    for (int threads = 1; threads <= 2 * hardware; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    sort(threadCounts.begin(), threadCounts.end());
+    threadCounts.erase(unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+    for (int threads : threadCounts) {
+        TuningConfig candidate;
+        candidate.threads = threads;
+        tryConfig(sampleName, candidate);
+    }
+
+    string chunkSampleName = writeSample(fileName, dir, AUTOTUNE_CHUNK_SAMPLE_BYTES, "chunk-sample");
+    ifstream chunkSample(chunkSampleName);
+    unsigned long chunkSampleBytes = getFileLength(chunkSample);
+    cout << "Chunk sizes on " << chunkSampleName << endl;
+    TuningConfig base = best;
+    best.throughput = 0;
+    tryConfig(chunkSampleName, base);
+    for (unsigned long chunkBytes : {16UL << 20, 4UL << 20, 1UL << 20, 256UL << 10}) {
+        if (chunkBytes * base.threads * AUTOTUNE_CHUNKS_PER_THREAD > chunkSampleBytes) {
+            cout << "  " << chunkBytes / 1024 << " KB chunks: skipped, too few per thread in the sample" << endl;
+            continue;
+        }
+        TuningConfig candidate = base;
+        candidate.chunkBytes = chunkBytes;
+        tryConfig(chunkSampleName, candidate);
+    }
+    if (chunkSampleName != fileName) {
+        remove(chunkSampleName.c_str());
+    }
+
+    base = best;
+    best.throughput = 0;
+    tryConfig(sampleName, base);
+    for (double tableScale : {0.25, 0.5, 2.0}) {
+        TuningConfig candidate = base;
+        candidate.tableScale = tableScale;
+        tryConfig(sampleName, candidate);
+    }
+
+    if (sampleName != fileName) {
+        remove(sampleName.c_str());
+    }
+    cout << "Best: " << describe(best) << " (" << (unsigned long)best.throughput << " MB/s)" << endl;
+    return best;
+}
@@ -0,0 +1,19 @@
+#ifndef PARALLELPROCESSING_AUTOTUNE_H
+#define PARALLELPROCESSING_AUTOTUNE_H
+
+#include <string>
+#include "TuningStore.h"
+
+const unsigned long AUTOTUNE_SAMPLE_BYTES = 16UL * 1024 * 1024; // calibration text, taken from evenly spaced ranges
+const unsigned long AUTOTUNE_CHUNK_SAMPLE_BYTES = 128UL * 1024 * 1024; // larger sample for the chunk size step
+const unsigned long AUTOTUNE_SAMPLE_RANGES = 16;
+const unsigned long AUTOTUNE_CHUNKS_PER_THREAD = 4;             // a chunk size is only tried if the sample has this many per thread
+const int AUTOTUNE_REPEATS = 2;                                 // best of this many runs per setting
+
+extern TuningConfig activeTuning; // chunkBytes and tableScale are read by the counting code
+
+std::string writeSample(const std::string& fileName, const std::string& dir, unsigned long bytes, const std::string& tag);
+double measureThroughput(const std::string& sampleName, const TuningConfig& config);
+TuningConfig autotune(const std::string& fileName, const std::string& dir, int defaultThreads);
+
+#endif //PARALLELPROCESSING_AUTOTUNE_H
@@ -0,0 +1,380 @@
+#ifndef PARALLELPROCESSING_BASICHASHMAP_H
+#define PARALLELPROCESSING_BASICHASHMAP_H
+
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include "HashNode.h"
+
+const unsigned long INSERT_BATCH = 16; // keys hashed and prefetched together by insertBatch
+
+// Hash policy: the full hash of a key, before reduction by the table size. Everything
+// that hashes a key (tables, sketches, partitioning across threads or ranks) goes
+// through this, so a word hashes the same everywhere.
+template <typename Key>
+struct KeyHash {
+    unsigned long operator()(const Key& key) const {
+        return std::hash<Key>()(key);
+    }
+};
+
+//64-bit FNV-1a for words
+template <>
+struct KeyHash<std::string> {
+    unsigned long operator()(const std::string& key) const {
+        uint64_t hash = 0xCBF29CE484222325ULL;
+        for (char c : key) {
+            hash ^= (unsigned char)c;
+            hash *= 0x100000001B3ULL;
+        }
+        return hash;
+    }
+};
+
+//murmur3 finalizer: spreads every bit of a hash over the top bits, for users that read those
+inline uint64_t mixHash(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+//which of `owners` (aggregators, ranks, partitions) owns a key's hash; mixes the high bits
+//in so ownership doesn't follow the buckets of the owner's table
+inline int ownerOf(unsigned long hash, unsigned long owners) {
+    return (int)(((hash * 0x9E3779B97F4A7C15ULL) >> 32) % owners);
+}
+
+// Combine operators fold a value into the one already stored for its key. Any
+// default-constructible type with the same call works, a captureless lambda included:
+// BasicHashMap<Key, Value, KeyHash<Key>, decltype(lambda)>
+struct SumCombine {
+    template <typename Value>
+    void operator()(Value& into, const Value& from) const { into += from; }
+};
+
+struct MinCombine {
+    template <typename Value>
+    void operator()(Value& into, const Value& from) const { if (from < into) into = from; }
+};
+
+struct MaxCombine {
+    template <typename Value>
+    void operator()(Value& into, const Value& from) const { if (into < from) into = from; }
+};
+
+// Storage policy: where the slot array and the nodes live. This one is plain heap
+// memory; NodeArena.h has the huge page version.
+struct HeapStorage {
+    static void* allocateSlots(unsigned long bytes, bool& mapped) {
+        mapped = false;
+        return calloc(bytes == 0 ? 1 : bytes, 1);
+    }
+    static void releaseSlots(void* slots, unsigned long, bool) {
+        free(slots);
+    }
+
+    template <typename Node>
+    struct Nodes {
+        template <typename... Args>
+        Node* create(Args&&... args) { return new Node(std::forward<Args>(args)...); }
+        bool ownsNodes() const { return false; } // the map deletes its own nodes
+    };
+};
+
+/**
+ * Chained hash table that aggregates a Value per Key, shared by every counter.
+ * Building, merging and iterating are written once here and specialized at compile time:
+ * - build: add/insert/insertBatch, for a table owned by one thread
+ * - merge: mergeFrom, safe from several threads into one table, one mutex per
+ *   segmentSize buckets
+ * - iterate: forEach, or the table and tableSize directly
+ * - grow: rehash, for a table whose size could not be estimated up front
+ * clear() keeps the slots and nodes for reuse, so a table can serve many small jobs.
+ * Only a table that has been cleared tracks the buckets it fills, so the next clear()
+ * can skip the others; tables that are never reused pay nothing for it.
+ */
+template <typename Key, typename Value, typename Hash = KeyHash<Key>, typename Combine = SumCombine,
+          typename Storage = HeapStorage>
+class BasicHashMap {
+public:
+    using Node = BasicHashNode<Key, Value>;
+
+    Node** table;
+    unsigned long tableSize;
+    std::mutex* bucketMutexes;
+
+    //Constructor
+    explicit BasicHashMap(unsigned long size) : tableSize(std::max(1UL, size)) {
+        table = (Node**)Storage::allocateSlots(tableSize * sizeof(Node*), tableMapped);
+        mutexCount = (tableSize + segmentSize - 1) / segmentSize; // Ceiling division
+        bucketMutexes = new std::mutex[mutexCount];
+        std::fill(table, table + tableSize, nullptr);
+    }
+
+    // Destructor
+    ~BasicHashMap() {
+        if (!nodes.ownsNodes()) {
+            for (unsigned long i = 0; i < tableSize; ++i) {
+                deleteChain(table[i]);
+            }
+            deleteChain(freeNodes);
+        }
+        Storage::releaseSlots(table, tableSize * sizeof(Node*), tableMapped);
+        delete[] bucketMutexes;
+    }
+
+    BasicHashMap(const BasicHashMap&) = delete;
+    BasicHashMap& operator=(const BasicHashMap&) = delete;
+
+    static unsigned long rawHash(const Key& key) {
+        return Hash()(key);
+    }
+
+    unsigned long hashFunction(const Key& key) const {
+        return rawHash(key) % tableSize;
+    }
+
+    unsigned long getSegmentIndex(unsigned long bucketIndex) const {
+        return bucketIndex / segmentSize;
+    }
+
+    //node for this table, reusing a cleared one first
+    Node* newNode(const Key& key, const Value& value) const {
+        if (freeNodes != nullptr) {
+            Node* node = freeNodes;
+            freeNodes = node->next;
+            node->key = key; // keeps the old key's buffer when it is big enough
+            node->value = value;
+            node->next = nullptr;
+            return node;
+        }
+        return nodes.create(key, value);
+    }
+
+    //combines `value` into `key`; true if the key was new to this table
+    bool add(const Key& key, const Value& value) const {
+        if (skipKey(key)) return false;
+        return combineAt(key, value, hashFunction(key));
+    }
+
+    //counts one occurrence of `key`
+    void insert(const Key& key) const {
+        add(key, Value(1));
+    }
+
+    /**
+     * Counts up to INSERT_BATCH keys at a time in three passes, so the cache misses
+     * overlap instead of each insert waiting on its own:
+     * 1. hash every key and prefetch its bucket slot
+     * 2. read the slots and prefetch the first node of each chain
+     * 3. probe the chains and count
+     * Returns how many of the keys were new to this table.
+     */
+    unsigned long insertBatch(const Key* keys, unsigned long count) const {
+        return insertBatchHashed(keys, nullptr, count);
+    }
+
+    //insertBatch for keys whose rawHash is already known (nullptr: hash them here)
+    unsigned long insertBatchHashed(const Key* keys, const unsigned long* hashes, unsigned long count) const {
+        unsigned long indices[INSERT_BATCH];
+        unsigned long added = 0;
+        for (unsigned long base = 0; base < count; base += INSERT_BATCH) {
+            unsigned long batch = std::min(INSERT_BATCH, count - base);
+            for (unsigned long i = 0; i < batch; i++) {
+                indices[i] = (hashes != nullptr ? hashes[base + i] : rawHash(keys[base + i])) % tableSize;
+                __builtin_prefetch(&table[indices[i]]);
+            }
+            for (unsigned long i = 0; i < batch; i++) {
+                Node* head = table[indices[i]];
+                if (head != nullptr) {
+                    __builtin_prefetch(head);
+                }
+            }
+            for (unsigned long i = 0; i < batch; i++) {
+                if (!skipKey(keys[base + i])) {
+                    added += combineAt(keys[base + i], Value(1), indices[i]);
+                }
+            }
+        }
+        return added;
+    }
+
+    //counts every word of a space separated string
+    void insertWords(const std::string& words) const requires std::is_same_v<Key, std::string> {
+        std::string batch[INSERT_BATCH];
+        unsigned long batched = 0;
+        size_t start = 0;
+        while (start <= words.size()) {
+            size_t end = words.find(' ', start);
+            if (end == std::string::npos) {
+                end = words.size();
+            }
+            batch[batched++] = words.substr(start, end - start);
+            if (batched == INSERT_BATCH) {
+                insertBatch(batch, batched);
+                batched = 0;
+            }
+
+            // Update start for the next word
+            start = end + 1;
+        }
+        insertBatch(batch, batched);
+    }
+
+    //folds every entry of `other` into this table; several threads may merge into it at once
+    void mergeFrom(const BasicHashMap& other) const {
+        untracked.store(true, std::memory_order_relaxed);
+        for (unsigned long i = 0; i < other.tableSize; ++i) {
+            for (Node* otherNode = other.table[i]; otherNode != nullptr; otherNode = otherNode->next) {
+                unsigned long index = hashFunction(otherNode->key);
+                std::lock_guard<std::mutex> lock(bucketMutexes[getSegmentIndex(index)]);
+                Node** slot = &table[index];
+                Node* node = *slot;
+                while (node != nullptr && node->key != otherNode->key) {
+                    node = node->next;
+                }
+                if (node != nullptr) {
+                    combine(node->value, otherNode->value);
+                } else {
+                    node = nodes.create(otherNode->key, otherNode->value);
+                    node->next = *slot;
+                    *slot = node;
+                }
+            }
+        }
+    }
+
+    //calls visit(key, value) for every entry, in bucket order
+    template <typename Visit>
+    void forEach(Visit visit) const {
+        for (unsigned long i = 0; i < tableSize; ++i) {
+            for (Node* node = table[i]; node != nullptr; node = node->next) {
+                visit(node->key, node->value);
+            }
+        }
+    }
+
+    //value stored for `key`, or nullptr
+    const Value* find(const Key& key) const {
+        for (Node* node = table[hashFunction(key)]; node != nullptr; node = node->next) {
+            if (node->key == key) {
+                return &node->value;
+            }
+        }
+        return nullptr;
+    }
+
+    unsigned long size() const {
+        unsigned long entries = 0;
+        forEach([&entries](const Key&, const Value&) { entries++; });
+        return entries;
+    }
+
+    //relinks every node into a new slot array of `size` buckets, for a table that outgrew its
+    //estimate; only while no other thread uses the table
+    void rehash(unsigned long size) {
+        size = std::max(1UL, size);
+        bool mapped;
+        Node** slots = (Node**)Storage::allocateSlots(size * sizeof(Node*), mapped);
+        std::fill(slots, slots + size, nullptr);
+        for (unsigned long i = 0; i < tableSize; ++i) {
+            Node* node = table[i];
+            while (node != nullptr) {
+                Node* next = node->next;
+                unsigned long index = rawHash(node->key) % size;
+                node->next = slots[index];
+                slots[index] = node;
+                node = next;
+            }
+        }
+        Storage::releaseSlots(table, tableSize * sizeof(Node*), tableMapped);
+        table = slots;
+        tableSize = size;
+        tableMapped = mapped;
+        delete[] bucketMutexes;
+        mutexCount = (tableSize + segmentSize - 1) / segmentSize;
+        bucketMutexes = new std::mutex[mutexCount];
+        usedBuckets.clear();
+        untracked.store(true, std::memory_order_relaxed); // bucket numbers changed, so clear() walks them all
+    }
+
+    //empties the table but keeps its slots and nodes for the next job; not safe during a merge
+    void clear() {
+        bool everyBucket = !trackBuckets || untracked.load(std::memory_order_relaxed);
+        unsigned long buckets = everyBucket ? tableSize : usedBuckets.size();
+        for (unsigned long i = 0; i < buckets; i++) {
+            unsigned long index = everyBucket ? i : usedBuckets[i];
+            Node* node = table[index];
+            while (node != nullptr) {
+                Node* next = node->next;
+                node->next = freeNodes;
+                freeNodes = node;
+                node = next;
+            }
+            table[index] = nullptr;
+        }
+        usedBuckets.clear();
+        untracked.store(false, std::memory_order_relaxed);
+        trackBuckets = true; // it is being reused, so from now on it lists the buckets it fills
+    }
+
+private:
+    unsigned long segmentSize = 1000; // buckets guarded by one mutex
+    unsigned long mutexCount;
+    bool tableMapped;                 // slot array came from an mmap in the storage policy
+    Combine combine;
+    mutable typename Storage::template Nodes<Node> nodes;
+    mutable Node* freeNodes = nullptr;                // nodes from clear(), used before new ones
+    bool trackBuckets = false;                        // set by the first clear()
+    mutable std::vector<unsigned long> usedBuckets;   // buckets filled by this thread's inserts, so clear() skips the rest
+    mutable std::atomic<bool> untracked{false};       // a merge filled buckets usedBuckets doesn't list
+
+    //empty words are dropped, as they always were
+    static bool skipKey(const Key& key) {
+        if constexpr (std::is_same_v<Key, std::string>) {
+            return key.empty();
+        } else {
+            return false;
+        }
+    }
+
+    //the probe: combines into `key` in bucket `index`; true if it was new to this table
+    bool combineAt(const Key& key, const Value& value, unsigned long index) const {
+        Node** slot = &table[index];
+        for (Node* currentNode = *slot; currentNode; currentNode = currentNode->next) {
+            if (currentNode->key == key) {
+                combine(currentNode->value, value);
+                return false;
+            }
+        }
+
+        // Node not found, create a new node and link it
+        Node* node = newNode(key, value);
+        if (trackBuckets && *slot == nullptr) {
+            usedBuckets.push_back(index);
+        }
+        node->next = *slot;
+        *slot = node;
+        return true;
+    }
+
+    void deleteChain(Node* node) {
+        while (node != nullptr) {
+            Node* temp = node;
+            node = node->next;
+            delete temp;
+        }
+    }
+};
+
+#endif //PARALLELPROCESSING_BASICHASHMAP_H
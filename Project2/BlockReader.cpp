@@ -0,0 +1,353 @@
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include "BlockReader.h"
+
+using namespace std;
+
+// The submission and completion rings shared with the kernel, set up with the raw
+// system calls so no liburing is needed
+struct UringQueue {
+    int fd = -1;
+    bool fixedBuffers = false;   // buffers registered, reads use IORING_OP_READ_FIXED
+    unsigned long inFlight = 0;
+    unsigned long toSubmit = 0;  // queued entries the kernel has not been told about yet
+    void* sqMapping = MAP_FAILED;
+    unsigned long sqMappingLength = 0;
+    void* cqMapping = MAP_FAILED;
+    unsigned long cqMappingLength = 0;
+    io_uring_sqe* sqes = (io_uring_sqe*)MAP_FAILED;
+    unsigned long sqesLength = 0;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    io_uring_cqe* cqes;
+};
+
+static int enterUring(UringQueue& ring, unsigned submit, unsigned waitFor) {
+    return (int)syscall(__NR_io_uring_enter, ring.fd, submit, waitFor, waitFor > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+}
+
+static void closeUring(UringQueue* ring) {
+    if (ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqesLength);
+    if (ring->cqMapping != MAP_FAILED && ring->cqMapping != ring->sqMapping) munmap(ring->cqMapping, ring->cqMappingLength);
+    if (ring->sqMapping != MAP_FAILED) munmap(ring->sqMapping, ring->sqMappingLength);
+    if (ring->fd >= 0) close(ring->fd);
+    delete ring;
+}
+
+/**
+ * Creates a ring with `entries` submission slots and maps its queues.
+ * Steps:
+ * 1. io_uring_setup, which fills in the offsets of every ring field
+ * 2. map the submission ring, the completion ring (one mapping on kernels with
+ *    IORING_FEAT_SINGLE_MMAP) and the submission entries
+ * 3. register the read buffers, so the kernel pins them once instead of on every
+ *    read; without that (e.g. a low memlock limit) plain reads are used
+ * Returns nullptr if the kernel has no io_uring or refuses it (e.g. a seccomp filter).
+ */
+static UringQueue* setupUring(unsigned entries, char* buffers, unsigned long slotBytes, unsigned long slots) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    UringQueue* ring = new UringQueue;
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) {
+        closeUring(ring);
+        return nullptr;
+    }
+
+    ring->sqMappingLength = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqMappingLength = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMapping) {
+        ring->sqMappingLength = ring->cqMappingLength = max(ring->sqMappingLength, ring->cqMappingLength);
+    }
+    ring->sqMapping = mmap(nullptr, ring->sqMappingLength, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sqMapping == MAP_FAILED) {
+        closeUring(ring);
+        return nullptr;
+    }
+    ring->cqMapping = singleMapping ? ring->sqMapping
+                                    : mmap(nullptr, ring->cqMappingLength, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    ring->sqesLength = params.sq_entries * sizeof(io_uring_sqe);
+    ring->sqes = (io_uring_sqe*)mmap(nullptr, ring->sqesLength, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->cqMapping == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        closeUring(ring);
+        return nullptr;
+    }
+
+    char* sq = (char*)ring->sqMapping;
+    char* cq = (char*)ring->cqMapping;
+    ring->sqTail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sqArray = (unsigned*)(sq + params.sq_off.array);
+    ring->cqHead = (unsigned*)(cq + params.cq_off.head);
+    ring->cqTail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    vector<iovec> iovecs(slots);
+    for (unsigned long i = 0; i < slots; i++) {
+        iovecs[i].iov_base = buffers + i * slotBytes;
+        iovecs[i].iov_len = slotBytes;
+    }
+    ring->fixedBuffers = syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, iovecs.data(), (unsigned)slots) == 0;
+    return ring;
+}
+
+BlockReader::BlockReader(unsigned long blockBytes, unsigned long queueDepth)
+        : fd(-1), fileSize(0), blockBytes(blockBytes), queueDepth(max(1UL, queueDepth)), blockCount(0),
+          nextToSubmit(0), nextToEmit(0), direct(false), error(false), buffers((char*)MAP_FAILED),
+          uring(nullptr) {}
+
+BlockReader::~BlockReader() {
+    if (uring != nullptr) {
+        // The kernel may still be writing into the buffers; let those reads land first
+        while (uring->inFlight > 0 && enterUring(*uring, (unsigned)uring->toSubmit, 1) >= 0) {
+            uring->toSubmit = 0;
+            unsigned head = *uring->cqHead;
+            unsigned tail = __atomic_load_n(uring->cqTail, __ATOMIC_ACQUIRE);
+            uring->inFlight -= tail - head;
+            __atomic_store_n(uring->cqHead, tail, __ATOMIC_RELEASE);
+        }
+        closeUring(uring);
+    }
+    if (buffers != MAP_FAILED) {
+        munmap(buffers, queueDepth * blockBytes);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+/**
+ * Opens the file for block reads.
+ * `direct` opens it with O_DIRECT, so a one-shot scan does not fill the page cache;
+ * block sizes are rounded up to the alignment O_DIRECT needs. Filesystems without
+ * O_DIRECT (e.g. tmpfs) fall back to cached reads, as does io_uring to pread.
+ */
+bool BlockReader::open(const string& fileName, bool useUring, bool useDirect) {
+    direct = useDirect;
+    fd = ::open(fileName.c_str(), O_RDONLY | (direct ? O_DIRECT : 0));
+    if (fd < 0 && direct && errno == EINVAL) {
+        cout << "O_DIRECT is not supported for " << fileName << "; reading through the page cache" << endl;
+        direct = false;
+        fd = ::open(fileName.c_str(), O_RDONLY);
+    }
+    if (fd < 0) {
+        cerr << "Error opening input file " << fileName << ": " << strerror(errno) << endl;
+        return false;
+    }
+    struct stat status;
+    fstat(fd, &status);
+    fileSize = status.st_size;
+
+    if (direct) {
+        blockBytes = (blockBytes + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+    }
+    blockCount = (fileSize + blockBytes - 1) / blockBytes;
+    queueDepth = max(1UL, min(queueDepth, blockCount));
+    // Page aligned, as O_DIRECT needs; calloc'd memory is not
+    buffers = (char*)mmap(nullptr, queueDepth * blockBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffers == MAP_FAILED) {
+        cerr << "Could not allocate " << queueDepth << " read buffers: " << strerror(errno) << endl;
+        return false;
+    }
+    filled.assign(queueDepth, 0);
+    slotBlock.assign(queueDepth, 0);
+    for (unsigned long slot = queueDepth; slot > 0; slot--) {
+        freeSlots.push_back(slot - 1);
+    }
+
+    if (useUring) {
+        uring = setupUring((unsigned)queueDepth, buffers, blockBytes, queueDepth);
+        if (uring == nullptr) {
+            cout << "io_uring is not available; reading with pread" << endl;
+        }
+    }
+    return true;
+}
+
+bool BlockReader::failed() const {
+    return error;
+}
+
+const char* BlockReader::backend() const {
+    if (uring == nullptr) return direct ? "pread, O_DIRECT" : "pread";
+    if (uring->fixedBuffers) return direct ? "io_uring, registered buffers, O_DIRECT" : "io_uring, registered buffers";
+    return direct ? "io_uring, O_DIRECT" : "io_uring";
+}
+
+unsigned long BlockReader::blockLength(unsigned long block) const {
+    return min(blockBytes, fileSize - block * blockBytes);
+}
+
+//queues the rest of the read for the block in `slot`
+bool BlockReader::submitRead(unsigned long slot) {
+    unsigned long block = slotBlock[slot];
+    unsigned long length = blockLength(block) - filled[slot];
+    if (direct) {
+        length = (length + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT; // short read at the end of file
+    }
+
+    unsigned tail = *uring->sqTail;
+    unsigned index = tail & *uring->sqMask;
+    io_uring_sqe* entry = &uring->sqes[index];
+    memset(entry, 0, sizeof(*entry));
+    entry->opcode = uring->fixedBuffers ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    entry->fd = fd;
+    entry->off = block * blockBytes + filled[slot];
+    entry->addr = (unsigned long)(buffers + slot * blockBytes + filled[slot]);
+    entry->len = (unsigned)length;
+    entry->buf_index = (unsigned short)slot;
+    entry->user_data = slot;
+    uring->sqArray[index] = index;
+    __atomic_store_n(uring->sqTail, tail + 1, __ATOMIC_RELEASE);
+    uring->toSubmit++;
+    uring->inFlight++;
+    return true;
+}
+
+//starts a read for the next blocks in file order into every free buffer
+bool BlockReader::submitReads() {
+    while (!freeSlots.empty() && nextToSubmit < blockCount) {
+        unsigned long slot = freeSlots.back();
+        freeSlots.pop_back();
+        slotBlock[slot] = nextToSubmit++;
+        filled[slot] = 0;
+        submitRead(slot);
+    }
+    if (uring->toSubmit > 0) {
+        if (enterUring(*uring, (unsigned)uring->toSubmit, 0) < 0) {
+            cerr << "io_uring_enter failed: " << strerror(errno) << endl;
+            return false;
+        }
+        uring->toSubmit = 0;
+    }
+    return true;
+}
+
+//waits for at least one read and collects every finished one
+bool BlockReader::waitForCompletions() {
+    if (enterUring(*uring, (unsigned)uring->toSubmit, 1) < 0 && errno != EINTR) {
+        cerr << "io_uring_enter failed: " << strerror(errno) << endl;
+        return false;
+    }
+    uring->toSubmit = 0;
+
+    unsigned head = *uring->cqHead;
+    unsigned tail = __atomic_load_n(uring->cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+        io_uring_cqe* completion = &uring->cqes[head & *uring->cqMask];
+        unsigned long slot = completion->user_data;
+        int result = completion->res;
+        uring->inFlight--;
+        if (result <= 0) {
+            cerr << "Read of block " << slotBlock[slot] << " failed: " << (result < 0 ? strerror(-result) : "unexpected end of file") << endl;
+            error = true;
+            continue;
+        }
+        filled[slot] = min(blockLength(slotBlock[slot]), filled[slot] + result);
+        if (filled[slot] < blockLength(slotBlock[slot])) {
+            submitRead(slot); // short read, queue the rest
+        } else {
+            completed[slotBlock[slot]] = slot;
+        }
+    }
+    __atomic_store_n(uring->cqHead, tail, __ATOMIC_RELEASE);
+    return !error;
+}
+
+//reads the next block into `slot` with pread
+bool BlockReader::readBlocking(unsigned long slot) {
+    unsigned long block = slotBlock[slot];
+    unsigned long length = blockLength(block);
+    while (filled[slot] < length) {
+        unsigned long request = length - filled[slot];
+        if (direct) {
+            request = (request + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+        }
+        ssize_t result = pread(fd, buffers + slot * blockBytes + filled[slot], request, block * blockBytes + filled[slot]);
+        if (result < 0 && errno == EINTR) continue;
+        if (result <= 0) {
+            cerr << "Read of block " << block << " failed: " << (result < 0 ? strerror(errno) : "unexpected end of file") << endl;
+            error = true;
+            return false;
+        }
+        filled[slot] = min(length, filled[slot] + result);
+    }
+    completed[block] = slot;
+    return true;
+}
+
+/**
+ * Hands on the next chunk of the file, ending at the last whitespace in the blocks read
+ * so far; the partial word after it is carried into the following chunk.
+ * Steps:
+ * 1. keep every free buffer busy with a read for the next block in file order
+ * 2. wait until the block due next has completed; later blocks that finish first wait
+ *    in `completed`, which is at most queueDepth blocks
+ * 3. copy it out after the carried word, free its buffer and refill it
+ */
+bool BlockReader::next(string& text) {
+    while (!error) {
+        if (nextToEmit == blockCount) {
+            text.swap(carry);
+            carry.clear();
+            return !text.empty();
+        }
+
+        auto ready = completed.find(nextToEmit);
+        if (ready == completed.end()) {
+            if (uring != nullptr) {
+                if (!submitReads() || !waitForCompletions()) {
+                    error = true;
+                }
+            } else {
+                unsigned long slot = freeSlots.back();
+                freeSlots.pop_back();
+                slotBlock[slot] = nextToSubmit++;
+                filled[slot] = 0;
+                readBlocking(slot);
+            }
+            continue;
+        }
+
+        unsigned long slot = ready->second;
+        completed.erase(ready);
+        const char* bytes = buffers + slot * blockBytes;
+        unsigned long length = blockLength(nextToEmit);
+        unsigned long cut = length;
+        while (cut > 0 && !isspace((unsigned char)bytes[cut - 1])) {
+            cut--;
+        }
+        if (cut == 0) {
+            carry.append(bytes, length); // no whitespace: the whole block is inside one word
+            text.clear();
+        } else {
+            text.assign(carry);
+            text.append(bytes, cut);
+            carry.assign(bytes + cut, length - cut);
+        }
+        freeSlots.push_back(slot);
+        nextToEmit++;
+        if (uring != nullptr && !submitReads()) {
+            error = true;
+        }
+        if (!text.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
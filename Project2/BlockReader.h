@@ -0,0 +1,50 @@
+#ifndef PARALLELPROCESSING_BLOCKREADER_H
+#define PARALLELPROCESSING_BLOCKREADER_H
+
+#include <string>
+#include <map>
+#include <vector>
+
+const unsigned long DIRECT_IO_ALIGNMENT = 4096; // O_DIRECT offsets, lengths and buffers
+
+struct UringQueue;
+
+// Reads a file as a sequence of whole-word text chunks with many block reads in flight.
+// With io_uring, up to queueDepth reads into registered buffers are queued at once and
+// complete in any order; next() hands them on in file order, carrying a word cut by a
+// block edge over to the next chunk. Without io_uring, each block is a blocking pread.
+class BlockReader {
+public:
+    BlockReader(unsigned long blockBytes, unsigned long queueDepth);
+    ~BlockReader();
+    bool open(const std::string& fileName, bool useUring, bool direct);
+    bool next(std::string& text); // false at the end of the file or on a read error
+    bool failed() const;
+    const char* backend() const;
+
+private:
+    int fd;
+    unsigned long fileSize;
+    unsigned long blockBytes;
+    unsigned long queueDepth;
+    unsigned long blockCount;
+    unsigned long nextToSubmit;       // block index of the next read to queue
+    unsigned long nextToEmit;         // block index next() hands on next
+    bool direct;
+    bool error;
+    char* buffers;                    // queueDepth * blockBytes, page aligned
+    std::vector<unsigned long> filled;     // bytes read so far into each buffer
+    std::vector<unsigned long> slotBlock;  // block index each buffer is reading
+    std::vector<unsigned long> freeSlots;
+    std::map<unsigned long, unsigned long> completed; // block index -> buffer, waiting for its turn
+    std::string carry;                // partial word from the end of the last chunk
+    UringQueue* uring;
+
+    unsigned long blockLength(unsigned long block) const;
+    bool submitReads();
+    bool submitRead(unsigned long slot);
+    bool waitForCompletions();
+    bool readBlocking(unsigned long slot);
+};
+
+#endif //PARALLELPROCESSING_BLOCKREADER_H
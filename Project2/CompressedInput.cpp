@@ -0,0 +1,400 @@
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <thread>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "CompressedInput.h"
+
+using namespace std;
+
+const unsigned long INFLATE_INPUT_BYTES = 1UL << 30; // zlib counts input in 32 bits
+
+//gzip, zstd, or a zstd skippable frame (pzstd writes one before each frame)
+InputFormat detectFormat(const string& fileName) {
+    unsigned char magic[4] = {0, 0, 0, 0};
+    ifstream file(fileName, ios::binary);
+    file.read((char*)magic, 4);
+    if (file.gcount() >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+        return InputFormat::Gzip;
+    }
+    if (file.gcount() == 4 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd && magic[0] == 0x28) {
+        return InputFormat::Zstd;
+    }
+    if (file.gcount() == 4 && (magic[0] & 0xf0) == 0x50 && magic[1] == 0x2a && magic[2] == 0x4d && magic[3] == 0x18) {
+        return InputFormat::Zstd;
+    }
+    return InputFormat::Plain;
+}
+
+const char* formatName(InputFormat format) {
+    switch (format) {
+        case InputFormat::Gzip: return "gzip";
+        case InputFormat::Zstd: return "zstd";
+        default: return "plain text";
+    }
+}
+
+bool zstdAvailable() {
+#ifdef HAVE_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Cuts decoded text into whole-word chunks for the pipeline, keeping the run's
+// first and last partial words aside (see DecodedRun)
+class ChunkEmitter {
+public:
+    unsigned long appended = 0;
+
+    ChunkEmitter(const function<void(string*)>& emit, DecodedRun& run) : emit(emit), run(run) {}
+
+    void append(const char* bytes, unsigned long length) {
+        pending.append(bytes, length);
+        appended += length;
+        if (pending.size() >= DECODED_CHUNK_BYTES) {
+            flush();
+        }
+    }
+
+    //hands on everything up to the last whitespace
+    void flush() {
+        if (!run.sawSpace) {
+            unsigned long first = 0;
+            while (first < pending.size() && !isspace((unsigned char)pending[first])) {
+                first++;
+            }
+            if (first == pending.size()) {
+                return; // still inside the first word
+            }
+            run.head = pending.substr(0, first);
+            run.sawSpace = true;
+            pending.erase(0, first);
+        }
+        unsigned long cut = pending.size();
+        while (cut > 0 && !isspace((unsigned char)pending[cut - 1])) {
+            cut--;
+        }
+        if (cut > 0) {
+            emit(new string(pending, 0, cut));
+            pending.erase(0, cut);
+        }
+    }
+
+    void finish() {
+        flush();
+        if (run.sawSpace) {
+            run.tail = pending;
+        } else {
+            run.head = pending;
+        }
+        pending.clear();
+    }
+
+private:
+    const function<void(string*)>& emit;
+    DecodedRun& run;
+    string pending;
+};
+
+static bool allZero(const unsigned char* data, unsigned long from, unsigned long size) {
+    for (unsigned long i = from; i < size; i++) {
+        if (data[i] != 0) return false;
+    }
+    return true;
+}
+
+//next offset at or after `from` that looks like a gzip member header: magic, deflate, no reserved flags
+static unsigned long nextGzipHeader(const unsigned char* data, unsigned long size, unsigned long from) {
+    while (from + 4 <= size) {
+        const void* found = memchr(data + from, 0x1f, size - from - 3);
+        if (found == nullptr) break;
+        from = (const unsigned char*)found - data;
+        if (data[from + 1] == 0x8b && data[from + 2] == 8 && (data[from + 3] & 0xe0) == 0) {
+            return from;
+        }
+        from++;
+    }
+    return size;
+}
+
+/**
+ * Inflates the gzip member at `start` and sets `end` just past its trailer. zlib checks
+ * the trailer's CRC-32 and length, so a member that decodes is a real one.
+ * While `probing`, the start is only a guess: the first MEMBER_PROBE_BYTES of output are
+ * held back and dropped if decoding fails. Data that is not a member fails within a few
+ * bytes in practice, so output past that point is handed on as it comes.
+ */
+static bool inflateMember(const unsigned char* data, unsigned long size, unsigned long start, unsigned long& end,
+                          ChunkEmitter& out, bool probing) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
+        return false;
+    }
+    vector<char> buffer(DECODE_BUFFER_BYTES);
+    string held;
+    int status;
+    do {
+        if (stream.avail_in == 0) {
+            unsigned long position = start + stream.total_in;
+            stream.next_in = (Bytef*)(data + position);
+            stream.avail_in = (uInt)min(size - position, INFLATE_INPUT_BYTES);
+        }
+        stream.next_out = (Bytef*)buffer.data();
+        stream.avail_out = (uInt)buffer.size();
+        status = inflate(&stream, Z_NO_FLUSH);
+        if (status != Z_OK && status != Z_STREAM_END) {
+            inflateEnd(&stream); // corrupt, truncated, or not a member at all
+            return false;
+        }
+        unsigned long produced = buffer.size() - stream.avail_out;
+        if (probing) {
+            held.append(buffer.data(), produced);
+            if (held.size() >= MEMBER_PROBE_BYTES) {
+                out.append(held.data(), held.size());
+                held.clear();
+                probing = false;
+            }
+        } else {
+            out.append(buffer.data(), produced);
+        }
+    } while (status != Z_STREAM_END);
+    out.append(held.data(), held.size());
+    end = start + stream.total_in;
+    inflateEnd(&stream);
+    return true;
+}
+
+/**
+ * Decodes the gzip members that start in [rangeStart, rangeEnd).
+ * Member boundaries are only known by decoding, so every run but the first guesses:
+ * it starts at the first header-like bytes in its range that decode as a whole member.
+ * It then follows the chain of members, and keeps going past rangeEnd to finish the
+ * member it is in. decompressInput checks afterwards that the runs link up.
+ */
+static void decodeGzipRun(const unsigned char* data, unsigned long size, unsigned long rangeStart, unsigned long rangeEnd,
+                          const function<void(string*)>& emit, DecodedRun& run) {
+    ChunkEmitter out(emit, run);
+    unsigned long position = rangeStart;
+    unsigned long end = 0;
+    if (rangeStart == 0) {
+        run.failed = !inflateMember(data, size, 0, end, out, false);
+    } else {
+        while (true) {
+            position = nextGzipHeader(data, size, position);
+            if (position >= rangeEnd) {
+                out.finish();
+                return; // no member starts in this range
+            }
+            unsigned long before = out.appended;
+            if (inflateMember(data, size, position, end, out, true)) {
+                break;
+            }
+            if (out.appended != before) {
+                run.failed = true; // a false start got past the probe; give up on this attempt
+                break;
+            }
+            position++;
+        }
+    }
+    run.firstStart = position;
+    run.decoded = !run.failed;
+
+    position = end;
+    while (!run.failed && position < rangeEnd && position < size) {
+        if (!inflateMember(data, size, position, end, out, false)) {
+            run.failed = !allZero(data, position, size); // some tools pad the last member with zeros
+            break;
+        }
+        position = end;
+    }
+    run.end = position;
+    out.finish();
+}
+
+#ifdef HAVE_ZSTD
+//compressed offsets of every frame, skippable ones included; empty if the data is not zstd
+vector<unsigned long> findZstdFrames(const unsigned char* data, unsigned long size) {
+    vector<unsigned long> starts;
+    unsigned long position = 0;
+    while (position < size) {
+        size_t length = ZSTD_findFrameCompressedSize(data + position, size - position);
+        if (ZSTD_isError(length)) {
+            cerr << "Corrupt zstd frame at byte " << position << ": " << ZSTD_getErrorName(length) << endl;
+            return {};
+        }
+        starts.push_back(position);
+        position += length;
+    }
+    return starts;
+}
+
+//decodes the zstd frames in [begin, end) as one stream
+static void decodeZstdRun(const unsigned char* data, unsigned long begin, unsigned long end,
+                          const function<void(string*)>& emit, DecodedRun& run) {
+    ChunkEmitter out(emit, run);
+    ZSTD_DCtx* context = ZSTD_createDCtx();
+    ZSTD_inBuffer input = {data + begin, end - begin, 0};
+    vector<char> buffer(DECODE_BUFFER_BYTES);
+    size_t remaining = 0;
+    bool outputFull = false;
+    while (input.pos < input.size || outputFull) {
+        ZSTD_outBuffer output = {buffer.data(), buffer.size(), 0};
+        remaining = ZSTD_decompressStream(context, &output, &input);
+        if (ZSTD_isError(remaining)) {
+            cerr << "zstd decoding failed: " << ZSTD_getErrorName(remaining) << endl;
+            run.failed = true;
+            break;
+        }
+        out.append(buffer.data(), output.pos);
+        outputFull = output.pos == output.size;
+    }
+    if (!run.failed && remaining != 0) {
+        cerr << "zstd input ends inside a frame" << endl;
+        run.failed = true;
+    }
+    ZSTD_freeDCtx(context);
+    run.firstStart = begin;
+    run.end = end;
+    run.decoded = !run.failed;
+    out.finish();
+}
+#else
+//without libzstd no frame can be decoded; no frames makes decompressInput fail
+vector<unsigned long> findZstdFrames(const unsigned char*, unsigned long) {
+    cerr << "zstd support not compiled in" << endl;
+    return {};
+}
+#endif
+
+/**
+ * Decompresses a gzip or zstd file with up to `decoders` threads, straight into `emit`
+ * as whole-word chunks; nothing is written to disk.
+ * Steps:
+ * 1. map the compressed file and split it into one run per decoder: zstd frames are
+ *    found from their headers without decoding; gzip runs are byte ranges whose
+ *    members each decoder finds itself
+ * 2. decode the runs in parallel; each hands on whole-word chunks as it goes
+ * 3. check the gzip runs link up member to member, then join the partial words at the
+ *    run boundaries in file order
+ * A file that is one member or frame is decoded by one thread, with the pipeline
+ * tokenizing each chunk while the next is decoded.
+ * Returns false on corrupt input, or if a gzip run started at a false member; the
+ * caller then counts again with one decoder.
+ */
+bool decompressInput(const string& fileName, InputFormat format, int decoders, const function<void(string*)>& emit) {
+#ifndef HAVE_ZSTD
+    if (format == InputFormat::Zstd) {
+        cerr << "zstd support not compiled in (libzstd was not found)" << endl;
+        return false;
+    }
+#endif
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        cerr << "Error opening input file " << fileName << "." << endl;
+        return false;
+    }
+    struct stat info;
+    fstat(fd, &info);
+    unsigned long size = info.st_size;
+    if (size == 0) {
+        close(fd);
+        return true;
+    }
+    const unsigned char* data = (const unsigned char*)mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        cerr << "Could not map " << fileName << "." << endl;
+        return false;
+    }
+
+    // Run k covers the compressed bytes [bounds[k], bounds[k + 1])
+    vector<unsigned long> bounds;
+    if (format == InputFormat::Zstd) {
+        vector<unsigned long> frames = findZstdFrames(data, size);
+        if (frames.empty()) {
+            munmap((void*)data, size);
+            return false;
+        }
+        bounds.push_back(0);
+        unsigned long frame = 0;
+        for (int k = 1; k < decoders; k++) {
+            unsigned long target = size / decoders * k;
+            while (frame < frames.size() && frames[frame] < target) {
+                frame++;
+            }
+            if (frame < frames.size() && frames[frame] > bounds.back()) {
+                bounds.push_back(frames[frame]);
+            }
+        }
+        bounds.push_back(size);
+        cout << "Decoding " << frames.size() << " zstd frames in " << bounds.size() - 1 << " runs" << endl;
+    } else {
+        for (int k = 0; k < decoders; k++) {
+            bounds.push_back(size / decoders * k);
+        }
+        bounds.push_back(size);
+    }
+
+    vector<DecodedRun> runs(bounds.size() - 1);
+    vector<thread> threads;
+    for (unsigned long k = 0; k < runs.size(); k++) {
+        threads.emplace_back([&, k]() {
+            if (format == InputFormat::Gzip) {
+                decodeGzipRun(data, size, bounds[k], bounds[k + 1], emit, runs[k]);
+            } else {
+#ifdef HAVE_ZSTD
+                decodeZstdRun(data, bounds[k], bounds[k + 1], emit, runs[k]);
+#endif
+            }
+        });
+    }
+    for (thread& decoder : threads) {
+        decoder.join();
+    }
+
+    // Every run must start where the one before it ended
+    bool linked = true;
+    unsigned long expected = 0;
+    for (const DecodedRun& run : runs) {
+        if (run.failed) {
+            linked = false;
+        } else if (run.decoded) {
+            linked = linked && run.firstStart == expected;
+            expected = run.end;
+        }
+    }
+    linked = linked && (expected == size || (format == InputFormat::Gzip && allZero(data, expected, size)));
+    munmap((void*)data, size);
+    if (!linked) {
+        return false;
+    }
+
+    string carry;
+    for (const DecodedRun& run : runs) {
+        if (!run.decoded) continue;
+        if (!run.sawSpace) {
+            carry += run.head;
+        } else {
+            carry += run.head;
+            if (!carry.empty()) {
+                emit(new string(std::move(carry)));
+            }
+            carry = run.tail;
+        }
+    }
+    if (!carry.empty()) {
+        emit(new string(std::move(carry)));
+    }
+    return true;
+}
@@ -0,0 +1,40 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <functional>
+
+using namespace std;
+
+#ifndef PARALLELPROCESSING_COMPRESSEDINPUT_H
+#define PARALLELPROCESSING_COMPRESSEDINPUT_H
+
+const unsigned long DECODE_BUFFER_BYTES = 256 * 1024;        // decompressor output per call
+const unsigned long DECODED_CHUNK_BYTES = 1024 * 1024;       // decoded text handed on at a time
+const unsigned long MEMBER_PROBE_BYTES = 4UL * 1024 * 1024;  // output held back while a guessed gzip member start is unconfirmed
+
+enum class InputFormat {
+    Plain,
+    Gzip,
+    Zstd
+};
+
+// What one decoder thread produced from its run of gzip members or zstd frames.
+// Whole words went straight to the pipeline; the text before its first whitespace and
+// after its last is kept so words cut at a run boundary can be joined in order.
+struct DecodedRun {
+    unsigned long firstStart = 0;  // compressed offset of the first member decoded
+    unsigned long end = 0;         // compressed offset just past the last one
+    bool decoded = false;          // true once a member was decoded
+    bool failed = false;
+    bool sawSpace = false;
+    string head;
+    string tail;
+};
+
+InputFormat detectFormat(const string& fileName);
+const char* formatName(InputFormat format);
+bool zstdAvailable();
+vector<unsigned long> findZstdFrames(const unsigned char* data, unsigned long size);
+bool decompressInput(const string& fileName, InputFormat format, int decoders, const function<void(string*)>& emit);
+
+#endif //PARALLELPROCESSING_COMPRESSEDINPUT_H
@@ -0,0 +1,191 @@
+#include <array>
+#include <cstring>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "CountIndex.h"
+#include "HugePages.h"
+
+static const char COUNT_INDEX_MAGIC[8] = {'W', 'C', 'I', 'N', 'D', 'E', 'X', '\0'};
+
+//Constructor
+CountIndex::CountIndex() : mapping(nullptr), mappingLength(0), header(nullptr),
+                           offsets(nullptr), counts(nullptr), strings(nullptr) {}
+
+// Destructor
+CountIndex::~CountIndex() {
+    close();
+}
+
+//maps the file and checks the header and section sizes; section checksums are left to verify()
+bool CountIndex::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (unsigned long)info.st_size < sizeof(CountIndexHeader)) {
+        ::close(fd);
+        return false;
+    }
+    mappingLength = info.st_size;
+    mapping = mmap(nullptr, mappingLength, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // the mapping keeps the file alive
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        return false;
+    }
+    adviseHugePages(mapping, mappingLength);
+
+    header = (const CountIndexHeader*)mapping;
+    unsigned long expected = sizeof(CountIndexHeader) + (2 * header->entries + 1) * sizeof(uint64_t) + header->stringBytes;
+    if (memcmp(header->magic, COUNT_INDEX_MAGIC, sizeof(COUNT_INDEX_MAGIC)) != 0 ||
+        header->version != COUNT_INDEX_VERSION ||
+        checksum(header, offsetof(CountIndexHeader, headerChecksum)) != header->headerChecksum ||
+        expected != mappingLength) {
+        close();
+        return false;
+    }
+    offsets = (const uint64_t*)(header + 1);
+    counts = offsets + header->entries + 1;
+    strings = (const char*)(counts + header->entries);
+    return true;
+}
+
+void CountIndex::close() {
+    if (mapping != nullptr) {
+        munmap(mapping, mappingLength);
+    }
+    mapping = nullptr;
+    mappingLength = 0;
+    header = nullptr;
+    offsets = nullptr;
+    counts = nullptr;
+    strings = nullptr;
+}
+
+//reads every section once; use after a crash or before trusting an index from elsewhere
+bool CountIndex::verify() const {
+    if (header == nullptr) {
+        return false;
+    }
+    if (checksum(offsets, (header->entries + 1) * sizeof(uint64_t)) != header->offsetsChecksum ||
+        checksum(counts, header->entries * sizeof(uint64_t)) != header->countsChecksum ||
+        checksum(strings, header->stringBytes) != header->stringsChecksum) {
+        return false;
+    }
+    // Offsets must climb and stay inside the string section
+    if (offsets[0] != 0 || offsets[header->entries] != header->stringBytes) {
+        return false;
+    }
+    for (unsigned long i = 0; i < header->entries; i++) {
+        if (offsets[i] > offsets[i + 1]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t CountIndex::generation() const {
+    return header == nullptr ? 0 : header->generation;
+}
+
+unsigned long CountIndex::size() const {
+    return header == nullptr ? 0 : header->entries;
+}
+
+std::string_view CountIndex::key(unsigned long i) const {
+    return std::string_view(strings + offsets[i], offsets[i + 1] - offsets[i]);
+}
+
+uint64_t CountIndex::count(unsigned long i) const {
+    return counts[i];
+}
+
+//binary search over the sorted keys
+uint64_t CountIndex::find(std::string_view word) const {
+    unsigned long low = 0;
+    unsigned long high = size();
+    while (low < high) {
+        unsigned long mid = low + (high - low) / 2;
+        if (key(mid) < word) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return (low < size() && key(low) == word) ? counts[low] : 0;
+}
+
+/**
+ * Writes a new index file.
+ * Steps:
+ * 1. Lay out the offsets, counts and key bytes
+ * 2. Fill in the header with the section checksums, then the header checksum
+ * 3. Write everything to `path`.tmp and rename it over `path`, so readers see
+ *    either the old generation or the new one, never half of a file
+ */
+bool CountIndex::write(const std::string& path, const std::vector<std::pair<std::string, uint64_t>>& entries, uint32_t generation) {
+    std::vector<uint64_t> keyOffsets(entries.size() + 1);
+    std::vector<uint64_t> keyCounts(entries.size());
+    std::string keyBytes;
+    for (unsigned long i = 0; i < entries.size(); i++) {
+        keyOffsets[i] = keyBytes.size();
+        keyCounts[i] = entries[i].second;
+        keyBytes += entries[i].first;
+    }
+    keyOffsets[entries.size()] = keyBytes.size();
+
+    CountIndexHeader fileHeader;
+    memset(&fileHeader, 0, sizeof(fileHeader));
+    memcpy(fileHeader.magic, COUNT_INDEX_MAGIC, sizeof(COUNT_INDEX_MAGIC));
+    fileHeader.version = COUNT_INDEX_VERSION;
+    fileHeader.generation = generation;
+    fileHeader.entries = entries.size();
+    fileHeader.stringBytes = keyBytes.size();
+    fileHeader.offsetsChecksum = checksum(keyOffsets.data(), keyOffsets.size() * sizeof(uint64_t));
+    fileHeader.countsChecksum = checksum(keyCounts.data(), keyCounts.size() * sizeof(uint64_t));
+    fileHeader.stringsChecksum = checksum(keyBytes.data(), keyBytes.size());
+    fileHeader.headerChecksum = checksum(&fileHeader, offsetof(CountIndexHeader, headerChecksum));
+
+    std::string tempPath = path + ".tmp";
+    std::ofstream outFile(tempPath, std::ios::binary | std::ios::trunc);
+    outFile.write((const char*)&fileHeader, sizeof(fileHeader));
+    outFile.write((const char*)keyOffsets.data(), keyOffsets.size() * sizeof(uint64_t));
+    outFile.write((const char*)keyCounts.data(), keyCounts.size() * sizeof(uint64_t));
+    outFile.write(keyBytes.data(), keyBytes.size());
+    outFile.close();
+    if (!outFile) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
+
+static std::array<uint32_t, 256> buildChecksumTable() {
+    std::array<uint32_t, 256> table;
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t value = i;
+        for (int bit = 0; bit < 8; bit++) {
+            value = (value & 1) ? (0xEDB88320u ^ (value >> 1)) : (value >> 1);
+        }
+        table[i] = value;
+    }
+    return table;
+}
+
+//CRC-32 (IEEE polynomial)
+uint32_t CountIndex::checksum(const void* data, unsigned long length) {
+    static const std::array<uint32_t, 256> table = buildChecksumTable();
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint32_t crc = 0xFFFFFFFFu;
+    for (unsigned long i = 0; i < length; i++) {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
@@ -0,0 +1,56 @@
+#ifndef PARALLELPROCESSING_COUNTINDEX_H
+#define PARALLELPROCESSING_COUNTINDEX_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+const uint32_t COUNT_INDEX_VERSION = 1;
+
+// Fixed 64 byte header at the start of an index file. The sections follow in order:
+// uint64 offsets[entries + 1] into the string section, uint64 counts[entries], then
+// the keys in byte order, back to back.
+struct CountIndexHeader {
+    char magic[8];              // "WCINDEX\0"
+    uint32_t version;
+    uint32_t generation;        // 1 for a fresh index, +1 for every merged update
+    uint64_t entries;
+    uint64_t stringBytes;
+    uint32_t offsetsChecksum;   // CRC-32 of each section
+    uint32_t countsChecksum;
+    uint32_t stringsChecksum;
+    uint8_t reserved[12];
+    uint32_t headerChecksum;    // CRC-32 of everything above
+};
+
+// Read-only view of a word count index through mmap. Opening checks only the header,
+// so it costs the same for any index size; verify() does the full checksum pass.
+class CountIndex {
+public:
+    CountIndex();
+    ~CountIndex();
+    bool open(const std::string& path);
+    void close();
+    bool verify() const;
+    uint32_t generation() const;
+    unsigned long size() const;
+    std::string_view key(unsigned long i) const;
+    uint64_t count(unsigned long i) const;
+    uint64_t find(std::string_view word) const; // 0 if the word is not in the index
+
+    // entries must be sorted by key; the file is written beside `path` and renamed over it
+    static bool write(const std::string& path, const std::vector<std::pair<std::string, uint64_t>>& entries, uint32_t generation);
+    static uint32_t checksum(const void* data, unsigned long length);
+
+private:
+    void* mapping;
+    unsigned long mappingLength;
+    const CountIndexHeader* header;
+    const uint64_t* offsets;
+    const uint64_t* counts;
+    const char* strings;
+};
+
+#endif //PARALLELPROCESSING_COUNTINDEX_H
@@ -0,0 +1,65 @@
+#include <cmath>
+#include <algorithm>
+#include "CountMinSketch.h"
+#include "HugePages.h"
+#include "BasicHashMap.h"
+
+//Constructor
+CountMinSketch::CountMinSketch(unsigned long width, unsigned long depth) : width(width), depth(depth), total(0) {
+    counts = (uint64_t*)allocateLarge(width * depth * sizeof(uint64_t), countsMapped);
+    std::fill(counts, counts + width * depth, 0);
+}
+
+// Destructor
+CountMinSketch::~CountMinSketch() {
+    releaseLarge(counts, width * depth * sizeof(uint64_t), countsMapped);
+}
+
+void CountMinSketch::add(const std::string& key, uint64_t count) {
+    if (key.empty()) return;
+
+    uint64_t hash = KeyHash<std::string>()(key); // the two halves seed the per-row hashes
+    uint64_t step = (hash >> 32) | 1; // double hashing: row i uses hash + i * step
+    for (unsigned long row = 0; row < depth; row++) {
+        counts[row * width + ((hash + row * step) & (width - 1))] += count;
+    }
+    total += count;
+}
+
+uint64_t CountMinSketch::estimate(const std::string& key) const {
+    uint64_t hash = KeyHash<std::string>()(key);
+    uint64_t step = (hash >> 32) | 1;
+    uint64_t smallest = UINT64_MAX;
+    for (unsigned long row = 0; row < depth; row++) {
+        smallest = std::min(smallest, counts[row * width + ((hash + row * step) & (width - 1))]);
+    }
+    return smallest;
+}
+
+// Adds counters [begin, end) of another sketch of the same shape. Threads merge
+// disjoint ranges at once; the loop is a plain elementwise add the compiler vectorizes.
+void CountMinSketch::mergeRange(const CountMinSketch& other, unsigned long begin, unsigned long end) {
+    uint64_t* __restrict mine = counts;
+    const uint64_t* __restrict theirs = other.counts;
+#pragma omp simd
+    for (unsigned long i = begin; i < end; i++) {
+        mine[i] += theirs[i];
+    }
+}
+
+double CountMinSketch::epsilon() const {
+    return std::exp(1.0) / width;
+}
+
+double CountMinSketch::delta() const {
+    return std::exp(-(double)depth);
+}
+
+// Widest power-of-two row that keeps depth rows within the byte budget
+unsigned long CountMinSketch::widthForBytes(unsigned long bytes, unsigned long depth) {
+    unsigned long width = 1;
+    while (width * 2 * depth * sizeof(uint64_t) <= bytes) {
+        width *= 2;
+    }
+    return width;
+}
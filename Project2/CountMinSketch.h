@@ -0,0 +1,31 @@
+#ifndef PARALLELPROCESSING_COUNTMINSKETCH_H
+#define PARALLELPROCESSING_COUNTMINSKETCH_H
+
+#include <string>
+#include <cstdint>
+
+// Fixed-size approximate counter: depth rows of width counters each.
+// An estimate never undercounts and overcounts by at most epsilon * total
+// with probability 1 - delta, where epsilon = e / width and delta = e^-depth.
+class CountMinSketch {
+public:
+    uint64_t* counts;
+    unsigned long width; // power of two so a row index is a mask
+    unsigned long depth;
+    uint64_t total;
+
+    CountMinSketch(unsigned long width, unsigned long depth);
+    ~CountMinSketch();
+    void add(const std::string& key, uint64_t count = 1);
+    uint64_t estimate(const std::string& key) const;
+    void mergeRange(const CountMinSketch& other, unsigned long begin, unsigned long end);
+    double epsilon() const;
+    double delta() const;
+
+    static unsigned long widthForBytes(unsigned long bytes, unsigned long depth);
+
+private:
+    bool countsMapped;
+};
+
+#endif //PARALLELPROCESSING_COUNTMINSKETCH_H
@@ -0,0 +1,347 @@
+#include <iostream>
+#include <cstring>
+#include <vector>
+#include "HashNode.h"
+#include "HashMap.h"
+#include "WordCount.h"
+#include "Utils.h"
+#include "HyperLogLog.h"
+#include "Autotune.h"
+#include "DistributedCount.h"
+
+using namespace std;
+
+//how far past the end of its range a rank reads at a time while finishing its last word
+const int SPILL_READ_SIZE = 256;
+//largest single MPI-IO read or write, kept under INT_MAX
+const MPI_Offset MAX_READ_SIZE = 1 << 30;
+//entries each rank contributes when choosing sample sort splitters
+const int SAMPLES_PER_RANK = 64;
+
+//rank that owns a word after the shuffle: the table's own hash, so ownership can't drift from it
+int partitionOf(const string& word, int worldSize) {
+    return ownerOf(HashMap::rawHash(word), worldSize);
+}
+
+//appends one (len, bytes, count) record
+void packEntry(vector<char>& buffer, const string& word, long count) {
+    int length = static_cast<int>(word.length());
+    size_t offset = buffer.size();
+    buffer.resize(offset + sizeof(length) + length + sizeof(count));
+    memcpy(&buffer[offset], &length, sizeof(length));
+    memcpy(&buffer[offset + sizeof(length)], word.data(), length);
+    memcpy(&buffer[offset + sizeof(length) + length], &count, sizeof(count));
+}
+
+//adds every (len, bytes, count) record in the buffer to the table
+void unpackEntries(const char* buffer, size_t length, HashMap& table) {
+    size_t offset = 0;
+    while (offset < length) {
+        int wordLength;
+        long count;
+        memcpy(&wordLength, buffer + offset, sizeof(wordLength));
+        string word(buffer + offset + sizeof(wordLength), wordLength);
+        memcpy(&count, buffer + offset + sizeof(wordLength) + wordLength, sizeof(count));
+        table.add(word, count);
+        offset += sizeof(wordLength) + wordLength + sizeof(count);
+    }
+}
+
+/**
+ * Reads the bytes [start, end) of the file and trims them to whole words.
+ * A word belongs to the rank whose range holds its first byte, so a word cut
+ * at `start` is dropped (the previous rank finishes it) and a word cut at
+ * `end` is completed by reading on past the end of the range.
+ */
+string readByteRange(MPI_File file, MPI_Offset start, MPI_Offset end, MPI_Offset fileSize) {
+    string block(end - start, '\0');
+    for (MPI_Offset offset = 0; offset < end - start; offset += MAX_READ_SIZE) {
+        int count = static_cast<int>(min(MAX_READ_SIZE, end - start - offset));
+        MPI_File_read_at(file, start + offset, &block[offset], count, MPI_CHAR, MPI_STATUS_IGNORE);
+    }
+
+    // Skip the tail of a word that started in the previous range
+    size_t first = 0;
+    if (start > 0) {
+        char previous;
+        MPI_File_read_at(file, start - 1, &previous, 1, MPI_CHAR, MPI_STATUS_IGNORE);
+        if (!isspace(static_cast<unsigned char>(previous))) {
+            while (first < block.length() && !isspace(static_cast<unsigned char>(block[first]))) {
+                first++;
+            }
+        }
+    }
+
+    // Finish a word that runs past the end of the range (unless the whole range was someone else's word)
+    MPI_Offset position = end;
+    bool wordOpen = first < block.length() && !isspace(static_cast<unsigned char>(block.back()));
+    while (wordOpen && position < fileSize) {
+        char spill[SPILL_READ_SIZE];
+        int count = static_cast<int>(min<MPI_Offset>(SPILL_READ_SIZE, fileSize - position));
+        MPI_File_read_at(file, position, spill, count, MPI_CHAR, MPI_STATUS_IGNORE);
+        int used = 0;
+        while (used < count && !isspace(static_cast<unsigned char>(spill[used]))) {
+            used++;
+        }
+        block.append(spill, used);
+        wordOpen = used == count;
+        position += count;
+    }
+
+    return block.substr(first);
+}
+
+//counts the words of this rank's byte range of the file into a new local table, and estimates
+//the table size each rank needs for the share of the vocabulary it will own
+void countByteRange(const string& fileName, int worldRank, int worldSize, HashMap*& localTable,
+                    unsigned long& ownedTableSize) {
+    MPI_File file;
+    MPI_File_open(MPI_COMM_WORLD, fileName.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file);
+    MPI_Offset fileSize;
+    MPI_File_get_size(file, &fileSize);
+
+    MPI_Offset chunkSize = fileSize / worldSize;
+    MPI_Offset start = worldRank * chunkSize;
+    MPI_Offset end = (worldRank == worldSize - 1) ? fileSize : start + chunkSize;
+    string block = readByteRange(file, start, end, fileSize);
+    MPI_File_close(&file);
+
+    // Split on whitespace like operator>> does, then normalize each word
+    auto forEachWord = [&block](auto visit) {
+        size_t wordStart = string::npos;
+        for (size_t i = 0; i <= block.length(); i++) {
+            bool space = i == block.length() || isspace(static_cast<unsigned char>(block[i]));
+            if (!space && wordStart == string::npos) {
+                wordStart = i;
+            } else if (space && wordStart != string::npos) {
+                visit(normalizeWord(block.substr(wordStart, i - wordStart)));
+                wordStart = string::npos;
+            }
+        }
+    };
+
+    // Size both tables from HyperLogLog estimates: this rank's block for the local table,
+    // and the registers max-reduced over all ranks for the share each rank will own
+    HyperLogLog estimator(HLL_PRECISION);
+    forEachWord([&estimator](const string& word) {
+        if (!word.empty()) estimator.add(word);
+    });
+    unsigned long localDistinct = static_cast<unsigned long>(estimator.estimate());
+    MPI_Allreduce(MPI_IN_PLACE, estimator.registers, static_cast<int>(estimator.registerCount),
+                  MPI_UNSIGNED_CHAR, MPI_MAX, MPI_COMM_WORLD);
+    ownedTableSize = max(100UL, static_cast<unsigned long>(estimator.estimate() / worldSize * activeTuning.tableScale));
+
+    localTable = new HashMap(max(100UL, static_cast<unsigned long>(localDistinct * activeTuning.tableScale)));
+    forEachWord([localTable](const string& word) {
+        localTable->insert(word);
+    });
+}
+
+//sends outgoing[rank] to each rank with MPI_Alltoall of sizes then MPI_Alltoallv, returns what arrived
+vector<char> exchangeBuffers(vector<vector<char>>& outgoing, int worldSize) {
+    vector<int> sendCounts(worldSize);
+    vector<int> sendDisplacements(worldSize);
+    vector<char> sendBuffer;
+    for (int rank = 0; rank < worldSize; rank++) {
+        sendCounts[rank] = static_cast<int>(outgoing[rank].size());
+        sendDisplacements[rank] = static_cast<int>(sendBuffer.size());
+        sendBuffer.insert(sendBuffer.end(), outgoing[rank].begin(), outgoing[rank].end());
+        vector<char>().swap(outgoing[rank]); // release as we go
+    }
+
+    vector<int> receiveCounts(worldSize);
+    vector<int> receiveDisplacements(worldSize);
+    MPI_Alltoall(sendCounts.data(), 1, MPI_INT, receiveCounts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    int totalReceived = 0;
+    for (int rank = 0; rank < worldSize; rank++) {
+        receiveDisplacements[rank] = totalReceived;
+        totalReceived += receiveCounts[rank];
+    }
+
+    vector<char> receiveBuffer(totalReceived);
+    MPI_Alltoallv(sendBuffer.data(), sendCounts.data(), sendDisplacements.data(), MPI_BYTE,
+                  receiveBuffer.data(), receiveCounts.data(), receiveDisplacements.data(), MPI_BYTE, MPI_COMM_WORLD);
+    return receiveBuffer;
+}
+
+/**
+ * Sends every entry of the local table to the rank that owns its word and
+ * sums what arrives into ownedTable. Entries travel as packed (len, bytes, count) records.
+ */
+void shuffleCounts(HashMap& localTable, HashMap& ownedTable, int worldSize) {
+    vector<vector<char>> outgoing(worldSize);
+    for (unsigned long i = 0; i < localTable.tableSize; ++i) {
+        for (HashNode* node = localTable.table[i]; node != nullptr; node = node->next) {
+            packEntry(outgoing[partitionOf(node->key, worldSize)], node->key, node->value);
+        }
+    }
+
+    vector<char> receiveBuffer = exchangeBuffers(outgoing, worldSize);
+    unpackEntries(receiveBuffer.data(), receiveBuffer.size(), ownedTable);
+}
+
+//same records as unpackEntries, but kept in order as WordCounts instead of summed into a table
+void unpackWordCounts(const char* buffer, size_t length, vector<WordCount*>& wordCounts) {
+    size_t offset = 0;
+    while (offset < length) {
+        int wordLength;
+        long count;
+        memcpy(&wordLength, buffer + offset, sizeof(wordLength));
+        string word(buffer + offset + sizeof(wordLength), wordLength);
+        memcpy(&count, buffer + offset + sizeof(wordLength) + wordLength, sizeof(count));
+        wordCounts.push_back(new WordCount(word, count));
+        offset += sizeof(wordLength) + wordLength + sizeof(count);
+    }
+}
+
+void deleteWordCounts(vector<WordCount*>& wordCounts) {
+    for (WordCount* wordCount : wordCounts) {
+        delete wordCount;
+    }
+    wordCounts.clear();
+}
+
+/**
+ * Picks worldSize - 1 splitters for the sample sort.
+ * Every rank contributes SAMPLES_PER_RANK evenly spaced entries of its sorted
+ * list; the samples are shared with MPI_Allgatherv and sorted the same way on
+ * every rank, so all ranks agree on the splitters without a root.
+ */
+vector<WordCount*> chooseSplitters(const vector<WordCount*>& sortedCounts, int worldSize) {
+    vector<char> samples;
+    int sampleCount = min(SAMPLES_PER_RANK, (int)sortedCounts.size());
+    for (int i = 0; i < sampleCount; i++) {
+        const WordCount* sample = sortedCounts[(size_t)i * sortedCounts.size() / sampleCount];
+        packEntry(samples, sample->word, sample->count);
+    }
+
+    int sampleBytes = static_cast<int>(samples.size());
+    vector<int> allBytes(worldSize);
+    vector<int> displacements(worldSize);
+    MPI_Allgather(&sampleBytes, 1, MPI_INT, allBytes.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    int totalBytes = 0;
+    for (int rank = 0; rank < worldSize; rank++) {
+        displacements[rank] = totalBytes;
+        totalBytes += allBytes[rank];
+    }
+    vector<char> allSamples(totalBytes);
+    MPI_Allgatherv(samples.data(), sampleBytes, MPI_BYTE, allSamples.data(), allBytes.data(),
+                   displacements.data(), MPI_BYTE, MPI_COMM_WORLD);
+
+    vector<WordCount*> pool;
+    unpackWordCounts(allSamples.data(), allSamples.size(), pool);
+    if (!pool.empty()) {
+        mergeSort(pool.data(), 0, (int)pool.size() - 1);
+    }
+
+    vector<WordCount*> splitters;
+    for (int rank = 1; rank < worldSize && !pool.empty(); rank++) {
+        WordCount* splitter = pool[(size_t)rank * pool.size() / worldSize];
+        splitters.push_back(new WordCount(splitter->word, splitter->count));
+    }
+    deleteWordCounts(pool);
+    return splitters;
+}
+
+/**
+ * Distributed sample sort of the owned counts, count descending.
+ * Each rank sorts its own entries, all ranks agree on splitters, every rank
+ * sends each slice of its sorted list to the rank that owns that key range,
+ * and each rank sorts what it receives. Rank r then holds the r-th slice of the
+ * final order, so no rank ever holds the whole vocabulary.
+ */
+void sortCountsDistributed(HashMap& ownedTable, int worldSize, vector<WordCount*>& sortedCounts) {
+    vector<WordCount*> localCounts;
+    for (unsigned long i = 0; i < ownedTable.tableSize; ++i) {
+        for (HashNode* node = ownedTable.table[i]; node != nullptr; node = node->next) {
+            localCounts.push_back(new WordCount(node->key, node->value));
+        }
+    }
+    if (!localCounts.empty()) {
+        mergeSort(localCounts.data(), 0, (int)localCounts.size() - 1);
+    }
+
+    vector<WordCount*> splitters = chooseSplitters(localCounts, worldSize);
+
+    // localCounts is sorted, so each destination gets one contiguous run
+    vector<vector<char>> outgoing(worldSize);
+    size_t destination = 0;
+    for (WordCount* wordCount : localCounts) {
+        while (destination < splitters.size() && !wordCountBefore(wordCount, splitters[destination])) {
+            destination++;
+        }
+        packEntry(outgoing[destination], wordCount->word, wordCount->count);
+    }
+    deleteWordCounts(localCounts);
+    deleteWordCounts(splitters);
+
+    vector<char> receiveBuffer = exchangeBuffers(outgoing, worldSize);
+    unpackWordCounts(receiveBuffer.data(), receiveBuffer.size(), sortedCounts);
+    if (!sortedCounts.empty()) {
+        mergeSort(sortedCounts.data(), 0, (int)sortedCounts.size() - 1);
+    }
+}
+
+/**
+ * Writes every rank's slice of the sorted counts into one file.
+ * An exclusive prefix sum of the slice sizes gives each rank its byte offset,
+ * and the slices go out with one collective MPI-IO write.
+ */
+void writeCountsParallel(const vector<WordCount*>& sortedCounts, const string& outputName) {
+    string text;
+    for (const WordCount* wordCount : sortedCounts) {
+        text += wordCount->word + ": " + to_string(wordCount->count) + "\n";
+    }
+
+    long long length = static_cast<long long>(text.length());
+    long long offset = 0;
+    MPI_Exscan(&length, &offset, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    int worldRank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &worldRank);
+    if (worldRank == 0) {
+        offset = 0; // MPI_Exscan leaves rank 0's result undefined
+    }
+
+    MPI_File file;
+    MPI_File_open(MPI_COMM_WORLD, outputName.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file);
+    MPI_File_set_size(file, 0); // drop any older, longer output
+    // Collective writes must be called the same number of times on every rank
+    long long pieces = (length + MAX_READ_SIZE - 1) / MAX_READ_SIZE;
+    long long maxPieces = 0;
+    MPI_Allreduce(&pieces, &maxPieces, 1, MPI_LONG_LONG, MPI_MAX, MPI_COMM_WORLD);
+    for (long long piece = 0; piece < maxPieces; piece++) {
+        long long written = min<long long>(piece * MAX_READ_SIZE, length);
+        int count = static_cast<int>(min<long long>(MAX_READ_SIZE, length - written));
+        MPI_File_write_at_all(file, offset + written, text.data() + written, count, MPI_CHAR, MPI_STATUS_IGNORE);
+    }
+    MPI_File_close(&file);
+}
+
+/**
+ *
+ * @param fileName
+ * @param worldRank, worldSize
+ * @param outputName
+ *
+ * Steps:
+ * 1. each rank counts its byte range of the file into a local table
+ * 2. entries are shuffled so each word lands on the rank that owns its hash
+ * 3. each rank sums the counts it received
+ * 4. the counts are sample sorted across ranks and written with collective MPI-IO
+ *
+ */
+void dispatchMPI(const string& fileName, int worldRank, int worldSize, const string& outputName) {
+    HashMap* localTable = nullptr;
+    unsigned long ownedTableSize = 0;
+    countByteRange(fileName, worldRank, worldSize, localTable, ownedTableSize);
+
+    // Each rank ends up with about 1/worldSize of the vocabulary
+    HashMap ownedTable(ownedTableSize);
+    shuffleCounts(*localTable, ownedTable, worldSize);
+    delete localTable;
+
+    vector<WordCount*> sortedCounts;
+    sortCountsDistributed(ownedTable, worldSize, sortedCounts);
+    writeCountsParallel(sortedCounts, outputName);
+    deleteWordCounts(sortedCounts);
+}
@@ -0,0 +1,27 @@
+#include <iostream>
+#include <vector>
+#include "HashMap.h"
+#include "WordCount.h"
+#include "/usr/local/Cellar/open-mpi/5.0.2/include/mpi.h"
+
+using namespace std;
+
+#ifndef PARALLELPROCESSING_DISTRIBUTEDCOUNT_H
+#define PARALLELPROCESSING_DISTRIBUTEDCOUNT_H
+
+int partitionOf(const string& word, int worldSize);
+void packEntry(vector<char>& buffer, const string& word, long count);
+void unpackEntries(const char* buffer, size_t length, HashMap& table);
+string readByteRange(MPI_File file, MPI_Offset start, MPI_Offset end, MPI_Offset fileSize);
+void countByteRange(const string& fileName, int worldRank, int worldSize, HashMap*& localTable,
+                    unsigned long& ownedTableSize);
+vector<char> exchangeBuffers(vector<vector<char>>& outgoing, int worldSize);
+void shuffleCounts(HashMap& localTable, HashMap& ownedTable, int worldSize);
+void unpackWordCounts(const char* buffer, size_t length, vector<WordCount*>& wordCounts);
+void deleteWordCounts(vector<WordCount*>& wordCounts);
+vector<WordCount*> chooseSplitters(const vector<WordCount*>& sortedCounts, int worldSize);
+void sortCountsDistributed(HashMap& ownedTable, int worldSize, vector<WordCount*>& sortedCounts);
+void writeCountsParallel(const vector<WordCount*>& sortedCounts, const string& outputName);
+void dispatchMPI(const string& fileName, int worldRank, int worldSize, const string& outputName);
+
+#endif //PARALLELPROCESSING_DISTRIBUTEDCOUNT_H
@@ -0,0 +1,410 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <cstdio>
+#include <atomic>
+#include <omp.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "HashNode.h"
+#include "HashMap.h"
+#include "HyperLogLog.h"
+#include "WordCount.h"
+#include "Utils.h"
+#include "ExternalCount.h"
+
+using namespace std;
+
+//partition of a word: the table's hash, spread by ownerOf so partitions don't follow buckets
+unsigned long partitionOfWord(const string& word, unsigned long partitions) {
+    return ownerOf(HashMap::rawHash(word), partitions);
+}
+
+//(uint32 length, bytes, uint64 count)
+void writeRecord(ostream& out, const string& word, uint64_t count) {
+    uint32_t length = word.size();
+    out.write((const char*)&length, sizeof(length));
+    out.write(word.data(), length);
+    out.write((const char*)&count, sizeof(count));
+}
+
+bool readRecord(istream& in, string& word, uint64_t& count) {
+    uint32_t length;
+    if (!in.read((char*)&length, sizeof(length))) {
+        return false;
+    }
+    word.resize(length);
+    in.read(&word[0], length);
+    in.read((char*)&count, sizeof(count));
+    return static_cast<bool>(in);
+}
+
+/**
+ * Writes every entry of `table` to `path`, partition after partition.
+ * The entries are bucketed by partition in memory first (pointers only), then
+ * each partition is written in one sequential run and its start recorded.
+ * Returns false if the file could not be written in full.
+ */
+bool spillTable(const HashMap& table, unsigned long partitions, const string& path, SpillFile& spill) {
+    vector<vector<const HashNode*>> grouped(partitions);
+    for (unsigned long i = 0; i < table.tableSize; i++) {
+        for (const HashNode* node = table.table[i]; node != nullptr; node = node->next) {
+            grouped[partitionOfWord(node->key, partitions)].push_back(node);
+        }
+    }
+
+    spill.path = path;
+    spill.offsets.resize(partitions + 1);
+    vector<char> buffer(SPILL_BUFFER_BYTES);
+    ofstream out;
+    out.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    out.open(path, ios::binary | ios::trunc);
+    for (unsigned long p = 0; p < partitions; p++) {
+        spill.offsets[p] = out.tellp();
+        for (const HashNode* node : grouped[p]) {
+            writeRecord(out, node->key, node->value);
+        }
+    }
+    spill.offsets[partitions] = out.tellp();
+    out.close();
+    if (!out) {
+        cerr << "Could not write spill file " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Adds up one partition from every spill file and writes it to `runPath`,
+ * sorted most frequent first, as a run for the final merge.
+ * Only this partition's words are in memory at once.
+ * Returns false if a spill file could not be read or the run could not be written.
+ */
+bool mergePartition(const vector<SpillFile>& spills, unsigned long partition, unsigned long tableSize, const string& runPath) {
+    HashMap table(tableSize);
+    vector<char> buffer(SPILL_BUFFER_BYTES);
+    string word;
+    uint64_t count;
+    for (const SpillFile& spill : spills) {
+        ifstream in;
+        in.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+        in.open(spill.path, ios::binary);
+        in.seekg(spill.offsets[partition]);
+        uint64_t remaining = spill.offsets[partition + 1] - spill.offsets[partition];
+        while (remaining > 0 && readRecord(in, word, count)) {
+            table.add(word, (long)count);
+            remaining -= sizeof(uint32_t) + word.size() + sizeof(uint64_t);
+        }
+        if (remaining > 0) {
+            cerr << "Could not read spill file " << spill.path << endl;
+            return false;
+        }
+    }
+
+    vector<WordCount*> wordCounts;
+    for (unsigned long i = 0; i < table.tableSize; i++) {
+        for (HashNode* node = table.table[i]; node != nullptr; node = node->next) {
+            wordCounts.push_back(new WordCount(node->key, node->value));
+        }
+    }
+    if (!wordCounts.empty()) {
+        mergeSort(wordCounts.data(), 0, (int)wordCounts.size() - 1);
+    }
+    ofstream out;
+    out.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    out.open(runPath, ios::binary | ios::trunc);
+    for (WordCount* wordCount : wordCounts) {
+        writeRecord(out, wordCount->word, wordCount->count);
+        delete wordCount;
+    }
+    out.close();
+    if (!out) {
+        cerr << "Could not write run file " << runPath << endl;
+        return false;
+    }
+    return true;
+}
+
+//runs merged at once: half the open file limit, so the merge leaves descriptors for everything else
+unsigned long mergeFanIn() {
+    rlimit limit;
+    unsigned long files = MAX_MERGE_FAN_IN * 2;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+        files = limit.rlim_cur;
+    }
+    return max(2UL, min(MAX_MERGE_FAN_IN, files / 2));
+}
+
+//k-way merge of sorted runs into `outputName`: text lines as outputHashMap writes them, or records for another pass
+bool mergeRunGroup(const vector<string>& runPaths, const string& outputName, bool text) {
+    struct Head {
+        WordCount entry;
+        unsigned long run;
+    };
+    auto after = [](const Head& a, const Head& b) {
+        return wordCountBefore(&b.entry, &a.entry);
+    };
+    priority_queue<Head, vector<Head>, decltype(after)> heads(after);
+
+    vector<ifstream> runs(runPaths.size());
+    string word;
+    uint64_t count;
+    for (unsigned long r = 0; r < runPaths.size(); r++) {
+        runs[r].open(runPaths[r], ios::binary);
+        if (!runs[r]) {
+            cerr << "Could not open run file " << runPaths[r] << endl;
+            return false;
+        }
+        if (readRecord(runs[r], word, count)) {
+            heads.push({WordCount(word, (long)count), r});
+        }
+    }
+
+    ofstream outFile(outputName, text ? ios::out | ios::trunc : ios::binary | ios::trunc);
+    if (!outFile) {
+        cerr << "Could not open " << outputName << " for writing" << endl;
+        return false;
+    }
+    while (!heads.empty()) {
+        Head head = heads.top();
+        heads.pop();
+        if (text) {
+            outFile << head.entry.word << ": " << head.entry.count << '\n';
+        } else {
+            writeRecord(outFile, head.entry.word, head.entry.count);
+        }
+        if (readRecord(runs[head.run], word, count)) {
+            heads.push({WordCount(word, (long)count), head.run});
+        }
+    }
+    outFile.close();
+    if (!outFile) {
+        cerr << "Could not write " << outputName << endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Merges the sorted runs into the output file, in the same order as outputHashMap.
+ * At most mergeFanIn() runs are open at once: while there are more, groups of that
+ * many are merged into intermediate runs named after `tempPrefix`, pass after pass.
+ * Intermediate runs are removed once merged; the original runs are left to the caller.
+ */
+bool mergeRuns(const vector<string>& runPaths, const string& tempPrefix, const string& outputName) {
+    unsigned long fanIn = mergeFanIn();
+    vector<string> current = runPaths;
+    bool intermediate = false;
+    for (int pass = 0; current.size() > fanIn; pass++) {
+        vector<string> next;
+        bool ok = true;
+        for (unsigned long first = 0; first < current.size() && ok; first += fanIn) {
+            vector<string> group(current.begin() + first, current.begin() + min(current.size(), first + fanIn));
+            next.push_back(tempPrefix + "pass" + to_string(pass) + "_" + to_string(next.size()) + ".run");
+            ok = mergeRunGroup(group, next.back(), false);
+        }
+        if (intermediate) {
+            for (const string& path : current) {
+                remove(path.c_str());
+            }
+        }
+        current = next;
+        intermediate = true;
+        if (!ok) {
+            for (const string& path : current) {
+                remove(path.c_str());
+            }
+            return false;
+        }
+    }
+    bool ok = mergeRunGroup(current, outputName, true);
+    if (intermediate) {
+        for (const string& path : current) {
+            remove(path.c_str());
+        }
+    }
+    return ok;
+}
+
+//peak resident memory of the process so far
+static void reportPeakMemory() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    unsigned long peakKilobytes = usage.ru_maxrss / 1024; // bytes on macOS
+#else
+    unsigned long peakKilobytes = usage.ru_maxrss;        // KiB on Linux
+#endif
+    cout << "Peak RSS: " << peakKilobytes / 1024 << " MiB" << endl;
+}
+
+/**
+ * Exact counting with a memory budget (external aggregation).
+ * Steps:
+ * 1. Estimate the vocabulary (HyperLogLog pre-pass) and choose enough hash
+ *    partitions that one partition's words fit in one thread's share of the budget
+ * 2. Count as usual, but when a thread table's estimated size passes its share,
+ *    spill it to a temp file grouped by partition and start a fresh table
+ * 3. If no table spilled, the count fit: merge the other thread tables into the
+ *    largest one, one at a time, freeing each as it is merged, and write outputName
+ *    as dispatchThreads would. Otherwise spill the last tables too
+ * 4. Merge the partitions in parallel, one per thread at a time, each into a
+ *    sorted run file
+ * 5. Merge the runs into outputName, which matches the in-memory output, at most
+ *    mergeFanIn() runs at a time
+ * Temp files go in spillDir and are removed at the end.
+ * Returns false, with nothing counted written, if a temp file or the output fails.
+ */
+bool dispatchThreadsExternal(int numThreads, const string& fileName, unsigned long memoryBytes,
+                             const string& spillDir, const string& outputName) {
+    unsigned long estimatedWords = 0;
+    unsigned long threadTableSize = 0;
+    estimateTableSizes(fileName, numThreads, estimatedWords, threadTableSize);
+
+    unsigned long threadBudget = max(1UL << 20, memoryBytes / numThreads);
+    // A table's slot array takes a quarter of its share at most; nodes get the rest
+    unsigned long tableSize = max(100UL, min(threadTableSize, threadBudget / 4 / sizeof(HashNode*)));
+    unsigned long nodeBudget = threadBudget - tableSize * sizeof(HashNode*);
+    unsigned long partitionWords = max(1UL, nodeBudget / NODE_BYTES_ESTIMATE);
+    // Merging a partition holds its words twice (table plus sorted copy), so partitions get half a table's words
+    unsigned long mergeWords = max(1UL, partitionWords / 2);
+    unsigned long partitions = max((unsigned long)numThreads, (estimatedWords + mergeWords - 1) / mergeWords);
+    cout << "Memory budget " << memoryBytes / (1024 * 1024) << " MiB: " << partitionWords << " words per thread table, "
+         << partitions << " spill partitions" << endl;
+
+    ifstream file(fileName);
+    unsigned long* threadIndices = splitFile(numThreads, file);
+    vector<vector<SpillFile>> threadSpills(numThreads);
+    vector<HashMap*> lastTables(numThreads, nullptr); // what is left in each thread table at the end
+    vector<unsigned long> lastWords(numThreads, 0);
+    atomic<bool> failed(false);                        // a spill could not be written
+    string prefix = spillDir + "/wordcount_" + to_string(getpid()) + "_";
+
+#pragma omp parallel num_threads(numThreads)
+    {
+        int i = omp_get_thread_num();
+        HashMap* threadTable = new HashMap(tableSize);
+        unsigned long tableWords = 0;
+
+        ifstream threadFile(fileName);
+        threadFile.seekg(threadIndices[i * 2]);
+        unsigned long end = threadIndices[i * 2 + 1];
+        string batch[INSERT_BATCH];
+        unsigned long batched = 0;
+        string word;
+        bool more = true;
+        while (more && !failed.load(memory_order_relaxed)) {
+            more = readWord(threadFile, end, word);
+            if (more) {
+                batch[batched] = normalizeWord(word);
+                if (batch[batched].empty()) continue;
+                batched++;
+            }
+            if (batched == INSERT_BATCH || (!more && batched > 0)) {
+                tableWords += threadTable->insertBatch(batch, batched);
+                batched = 0;
+            }
+            // Spill when over budget; the last table stays in memory until we know whether anything spilled
+            if (more && tableWords >= partitionWords) {
+                string path = prefix + to_string(i) + "_" + to_string(threadSpills[i].size()) + ".spill";
+                threadSpills[i].emplace_back();
+                if (!spillTable(*threadTable, partitions, path, threadSpills[i].back())) {
+                    failed.store(true);
+                }
+                delete threadTable;
+                threadTable = new HashMap(tableSize);
+                tableWords = 0;
+            }
+        }
+        lastTables[i] = threadTable;
+        lastWords[i] = tableWords;
+    }
+    delete[] threadIndices;
+
+    // Removes every temp file, for the end of the count or a failure
+    vector<string> runPaths(partitions);
+    auto removeTempFiles = [&]() {
+        for (const auto& list : threadSpills) {
+            for (const SpillFile& spill : list) {
+                remove(spill.path.c_str());
+            }
+        }
+        for (const string& path : runPaths) {
+            if (!path.empty()) remove(path.c_str());
+        }
+    };
+
+    bool spilled = false;
+    for (const auto& list : threadSpills) {
+        spilled = spilled || !list.empty();
+    }
+    if (!spilled) {
+        // Everything fit. The largest thread table takes in the others, one at a time, each freed
+        // as soon as it is merged, so memory peaks at the budget plus one thread's share
+        cout << "Spilled 0 tables" << endl;
+        int largest = (int)(max_element(lastWords.begin(), lastWords.end()) - lastWords.begin());
+        HashMap& mainTable = *lastTables[largest];
+        mainTable.rehash(max(mainTable.tableSize, estimatedWords));
+        for (int i = 0; i < numThreads; i++) {
+            if (i == largest) continue;
+            mergeResults(mainTable, lastTables[i]);
+            delete lastTables[i];
+        }
+        outputHashMap(mainTable, outputName);
+        delete lastTables[largest];
+        reportPeakMemory();
+        return true;
+    }
+
+    // Something spilled, so every word has to go through the runs: spill what is left as well
+#pragma omp parallel for num_threads(numThreads)
+    for (int i = 0; i < numThreads; i++) {
+        if (!failed.load() && lastWords[i] > 0) {
+            string path = prefix + to_string(i) + "_" + to_string(threadSpills[i].size()) + ".spill";
+            threadSpills[i].emplace_back();
+            if (!spillTable(*lastTables[i], partitions, path, threadSpills[i].back())) {
+                failed.store(true);
+            }
+        }
+        delete lastTables[i];
+    }
+    if (failed.load()) {
+        removeTempFiles();
+        cerr << "Could not spill to " << spillDir << "; nothing was written" << endl;
+        return false;
+    }
+
+    vector<SpillFile> spills;
+    for (auto& list : threadSpills) {
+        spills.insert(spills.end(), list.begin(), list.end());
+    }
+    cout << "Spilled " << spills.size() << " tables" << endl;
+
+    unsigned long partitionTableSize = max(100UL, estimatedWords / partitions);
+#pragma omp parallel for num_threads(numThreads) schedule(dynamic)
+    for (unsigned long p = 0; p < partitions; p++) {
+        runPaths[p] = prefix + "run_" + to_string(p) + ".run";
+        if (!failed.load() && !mergePartition(spills, p, partitionTableSize, runPaths[p])) {
+            failed.store(true);
+        }
+    }
+    for (const SpillFile& spill : spills) {
+        remove(spill.path.c_str());
+    }
+    if (failed.load()) {
+        removeTempFiles();
+        return false;
+    }
+
+    bool merged = mergeRuns(runPaths, prefix, outputName);
+    removeTempFiles();
+    if (!merged) {
+        remove(outputName.c_str());
+        return false;
+    }
+
+    reportPeakMemory();
+    return true;
+}
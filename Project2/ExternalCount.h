@@ -0,0 +1,34 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include "HashMap.h"
+#include "WordCount.h"
+
+using namespace std;
+
+#ifndef PARALLELPROCESSING_EXTERNALCOUNT_H
+#define PARALLELPROCESSING_EXTERNALCOUNT_H
+
+const unsigned long NODE_BYTES_ESTIMATE = sizeof(HashNode) + 16; // a node plus malloc's own header
+const unsigned long SPILL_BUFFER_BYTES = 64 * 1024;              // read/write buffer per open spill file
+const unsigned long MAX_MERGE_FAN_IN = 64;                       // runs open at once in the final merge
+
+// One spill: every entry of a thread table, grouped by partition.
+// Partition p is the bytes [offsets[p], offsets[p + 1]) of the file.
+struct SpillFile {
+    string path;
+    vector<uint64_t> offsets;
+};
+
+unsigned long partitionOfWord(const string& word, unsigned long partitions);
+void writeRecord(ostream& out, const string& word, uint64_t count);
+bool readRecord(istream& in, string& word, uint64_t& count);
+bool spillTable(const HashMap& table, unsigned long partitions, const string& path, SpillFile& spill);
+bool mergePartition(const vector<SpillFile>& spills, unsigned long partition, unsigned long tableSize, const string& runPath);
+unsigned long mergeFanIn();
+bool mergeRunGroup(const vector<string>& runPaths, const string& outputName, bool text);
+bool mergeRuns(const vector<string>& runPaths, const string& tempPrefix, const string& outputName);
+bool dispatchThreadsExternal(int numThreads, const string& fileName, unsigned long memoryBytes,
+                             const string& spillDir, const string& outputName);
+
+#endif //PARALLELPROCESSING_EXTERNALCOUNT_H
@@ -0,0 +1,150 @@
+#include <algorithm>
+#include "FrozenCounts.h"
+
+//Constructor
+FrozenCounts::FrozenCounts(const std::vector<std::pair<std::string, uint64_t>>& sortedEntries) {
+    unsigned long n = sortedEntries.size();
+    offsets.resize(n + 1);
+    counts.resize(n);
+    for (unsigned long i = 0; i < n; i++) {
+        offsets[i] = strings.size();
+        counts[i] = sortedEntries[i].second;
+        strings += sortedEntries[i].first;
+    }
+    offsets[n] = strings.size();
+
+    layout.resize(n + 1);
+    prefixes.resize(n + 1);
+    fillLayout(0, 1);
+
+    // Most frequent first, ties alphabetical, as in the output files
+    ranking.resize(n);
+    for (unsigned long i = 0; i < n; i++) {
+        ranking[i] = i;
+    }
+    std::stable_sort(ranking.begin(), ranking.end(), [this](uint32_t a, uint32_t b) {
+        return counts[a] > counts[b];
+    });
+}
+
+//in-order walk of the implicit tree hands out sorted positions; returns the next unused one
+unsigned long FrozenCounts::fillLayout(unsigned long i, unsigned long k) {
+    if (k < layout.size()) {
+        i = fillLayout(i, 2 * k);
+        layout[k] = i;
+        prefixes[k] = keyPrefix(key(i));
+        i++;
+        i = fillLayout(i, 2 * k + 1);
+    }
+    return i;
+}
+
+unsigned long FrozenCounts::size() const {
+    return counts.size();
+}
+
+std::string_view FrozenCounts::key(unsigned long i) const {
+    return std::string_view(strings.data() + offsets[i], offsets[i + 1] - offsets[i]);
+}
+
+uint64_t FrozenCounts::count(unsigned long i) const {
+    return counts[i];
+}
+
+unsigned long FrozenCounts::ranked(unsigned long rank) const {
+    return ranking[rank];
+}
+
+//words hold no NUL bytes, so zero padding keeps the integer order the same as the byte order
+uint64_t FrozenCounts::keyPrefix(std::string_view word) {
+    uint64_t prefix = 0;
+    for (unsigned long i = 0; i < 8; i++) {
+        prefix = (prefix << 8) | (i < word.size() ? (unsigned char)word[i] : 0);
+    }
+    return prefix;
+}
+
+bool FrozenCounts::nodeLess(unsigned long k, uint64_t wordPrefix, std::string_view word) const {
+    if (prefixes[k] != wordPrefix) {
+        return prefixes[k] < wordPrefix;
+    }
+    return key(layout[k]) < word;
+}
+
+//k is where the descent fell off the tree; undo the trailing right turns to find the lower bound
+uint64_t FrozenCounts::finish(unsigned long k, std::string_view word) const {
+    k >>= __builtin_ffsl(~k);
+    if (k == 0 || key(layout[k]) != word) {
+        return 0;
+    }
+    return counts[layout[k]];
+}
+
+uint64_t FrozenCounts::get(std::string_view word) const {
+    uint64_t wordPrefix = keyPrefix(word);
+    unsigned long n = size();
+    unsigned long k = 1;
+    while (k <= n) {
+        __builtin_prefetch(prefixes.data() + 8 * k); // four levels down shares one cache line
+        k = 2 * k + nodeLess(k, wordPrefix, word);
+    }
+    return finish(k, word);
+}
+
+/**
+ * Looks up many words at once.
+ * All searches step down the tree together, one level per pass, so the cache
+ * misses of different words overlap instead of being paid one after another.
+ */
+void FrozenCounts::getBatch(const std::vector<std::string_view>& words, std::vector<uint64_t>& results) const {
+    unsigned long n = size();
+    std::vector<uint64_t> wordPrefixes(words.size());
+    std::vector<unsigned long> positions(words.size(), 1);
+    for (unsigned long w = 0; w < words.size(); w++) {
+        wordPrefixes[w] = keyPrefix(words[w]);
+    }
+
+    bool moving = n > 0;
+    while (moving) {
+        moving = false;
+        for (unsigned long w = 0; w < words.size(); w++) {
+            unsigned long k = positions[w];
+            if (k <= n) {
+                k = 2 * k + nodeLess(k, wordPrefixes[w], words[w]);
+                __builtin_prefetch(prefixes.data() + k);
+                positions[w] = k;
+                moving = true;
+            }
+        }
+    }
+
+    results.resize(words.size());
+    for (unsigned long w = 0; w < words.size(); w++) {
+        results[w] = n == 0 ? 0 : finish(positions[w], words[w]);
+    }
+}
+
+//the words sharing a prefix are next to each other in sorted order
+std::pair<unsigned long, unsigned long> FrozenCounts::prefixRange(std::string_view prefix) const {
+    unsigned long low = 0;
+    unsigned long high = size();
+    while (low < high) {
+        unsigned long mid = low + (high - low) / 2;
+        if (key(mid) < prefix) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    unsigned long first = low;
+    high = size();
+    while (low < high) {
+        unsigned long mid = low + (high - low) / 2;
+        if (key(mid).substr(0, prefix.size()) == prefix) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return {first, low};
+}
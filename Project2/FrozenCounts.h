@@ -0,0 +1,40 @@
+#ifndef PARALLELPROCESSING_FROZENCOUNTS_H
+#define PARALLELPROCESSING_FROZENCOUNTS_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+// Read-only word counts laid out for lookups.
+// Keys are kept sorted for prefix ranges. Exact lookups walk an Eytzinger (BFS order)
+// copy of the sorted keys: the next nodes to visit sit together in memory and can be
+// prefetched. Each node holds the first 8 bytes of its key, so most steps compare one
+// integer and never touch the key bytes.
+class FrozenCounts {
+public:
+    explicit FrozenCounts(const std::vector<std::pair<std::string, uint64_t>>& sortedEntries);
+    unsigned long size() const;
+    uint64_t get(std::string_view word) const;
+    void getBatch(const std::vector<std::string_view>& words, std::vector<uint64_t>& results) const;
+    std::pair<unsigned long, unsigned long> prefixRange(std::string_view prefix) const; // sorted positions [first, last)
+    std::string_view key(unsigned long i) const;
+    uint64_t count(unsigned long i) const;
+    unsigned long ranked(unsigned long rank) const; // sorted position of the rank-th most frequent word
+
+private:
+    std::string strings;
+    std::vector<uint64_t> offsets;
+    std::vector<uint64_t> counts;
+    std::vector<uint32_t> layout;    // 1-based Eytzinger order; layout[k] is a sorted position
+    std::vector<uint64_t> prefixes;  // big-endian first 8 bytes of layout[k]'s key
+    std::vector<uint32_t> ranking;
+
+    unsigned long fillLayout(unsigned long i, unsigned long k);
+    bool nodeLess(unsigned long k, uint64_t wordPrefix, std::string_view word) const;
+    uint64_t finish(unsigned long k, std::string_view word) const;
+    static uint64_t keyPrefix(std::string_view word);
+};
+
+#endif //PARALLELPROCESSING_FROZENCOUNTS_H
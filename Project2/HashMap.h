@@ -1,19 +1,12 @@
 #ifndef PARALLELPROCESSING_HASHMAP_H
 #define PARALLELPROCESSING_HASHMAP_H
 
-#include "HashNode.h"
 #include <string>
+#include "HashNode.h"
+#include "BasicHashMap.h"
+#include "NodeArena.h"
 
-class HashMap {
-public:
-    HashNode** table;
-    unsigned long tableSize;
-    unsigned long hashFunction(const std::string& key) const;
-
-    explicit HashMap(unsigned long size);
-    ~HashMap();
-    void insert(const std::string& key) const;
-    void insertWords(const std::string& words) const;
-};
+// Word counts: occurrences summed per word, on huge pages when they are on
+using HashMap = BasicHashMap<std::string, long, KeyHash<std::string>, SumCombine, LargePageStorage>;
 
 #endif //PARALLELPROCESSING_HASHMAP_H
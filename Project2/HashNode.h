@@ -5,14 +5,17 @@
 
 using namespace std;
 
-class HashNode {
+template <typename Key, typename Value>
+class BasicHashNode {
 public:
-    string key;
-    long value;
-    HashNode* next;
+    Key key;
+    Value value;
+    BasicHashNode* next;
 
     //rather than making a copy of a copy, move the copy to the parameter to reduce memory usage
-    HashNode(string key, long value) : key(std::move(key)), value(value), next(nullptr) {}
+    BasicHashNode(Key key, Value value) : key(std::move(key)), value(std::move(value)), next(nullptr) {}
 };
 
+using HashNode = BasicHashNode<string, long>; // a word and its count
+
 #endif //PARALLELPROCESSING_HASHNODE_H
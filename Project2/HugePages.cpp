@@ -0,0 +1,77 @@
+#include <cstdlib>
+#include <cstdint>
+#include <sys/mman.h>
+#include "HugePages.h"
+
+static bool hugePages = false;
+
+//set once from main before any table is allocated
+void configureHugePages(bool enabled) {
+    hugePages = enabled;
+}
+
+bool hugePagesEnabled() {
+    return hugePages;
+}
+
+static unsigned long roundUp(unsigned long bytes, unsigned long alignment) {
+    return (bytes + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * Zeroed storage for `bytes`; `mapped` says how to give it back.
+ * Steps when huge pages are on and the array is big enough:
+ * 1. Try explicit 2 MB pages (only works if the admin reserved some)
+ * 2. Otherwise map 2 MB more than needed, trim to a 2 MB boundary and ask
+ *    for transparent huge pages, which the kernel can only use on aligned ranges
+ */
+void* allocateLarge(unsigned long bytes, bool& mapped) {
+    mapped = false;
+    if (!hugePages || bytes < HUGE_PAGE_SIZE) {
+        return calloc(bytes == 0 ? 1 : bytes, 1);
+    }
+    unsigned long length = roundUp(bytes, HUGE_PAGE_SIZE);
+
+#ifdef MAP_HUGETLB
+    void* explicitPages = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (explicitPages != MAP_FAILED) {
+        mapped = true;
+        return explicitPages;
+    }
+#endif
+
+    void* region = mmap(nullptr, length + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        return calloc(bytes, 1);
+    }
+    uintptr_t start = (uintptr_t)region;
+    uintptr_t aligned = roundUp(start, HUGE_PAGE_SIZE);
+    if (aligned > start) {
+        munmap(region, aligned - start);
+    }
+    uintptr_t tail = aligned + length;
+    uintptr_t regionEnd = start + length + HUGE_PAGE_SIZE;
+    if (regionEnd > tail) {
+        munmap((void*)tail, regionEnd - tail);
+    }
+    adviseHugePages((void*)aligned, length);
+    mapped = true;
+    return (void*)aligned;
+}
+
+void releaseLarge(void* address, unsigned long bytes, bool mapped) {
+    if (mapped) {
+        munmap(address, roundUp(bytes, HUGE_PAGE_SIZE));
+    } else {
+        free(address);
+    }
+}
+
+//asks for transparent huge pages on an existing mapping (tables, or a mapped input file)
+void adviseHugePages(void* address, unsigned long bytes) {
+#ifdef MADV_HUGEPAGE
+    if (hugePages && bytes >= HUGE_PAGE_SIZE) {
+        madvise(address, bytes, MADV_HUGEPAGE);
+    }
+#endif
+}
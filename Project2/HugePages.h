@@ -0,0 +1,17 @@
+#ifndef PARALLELPROCESSING_HUGEPAGES_H
+#define PARALLELPROCESSING_HUGEPAGES_H
+
+const unsigned long HUGE_PAGE_SIZE = 2UL * 1024 * 1024; // arrays smaller than this stay on the heap
+
+// Allocation backend for big flat arrays (hash table slots, sketch counters, n-gram tables).
+// With huge pages on, an array of at least HUGE_PAGE_SIZE is mapped from explicit 2 MB
+// pages (MAP_HUGETLB) when the system has some reserved. Otherwise it is a 2 MB aligned
+// anonymous mapping marked MADV_HUGEPAGE for transparent huge pages. Everything else is
+// calloc. Memory comes back zeroed either way.
+void configureHugePages(bool enabled);
+bool hugePagesEnabled();
+void* allocateLarge(unsigned long bytes, bool& mapped);
+void releaseLarge(void* address, unsigned long bytes, bool mapped);
+void adviseHugePages(void* address, unsigned long bytes);
+
+#endif //PARALLELPROCESSING_HUGEPAGES_H
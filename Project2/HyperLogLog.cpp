@@ -0,0 +1,57 @@
+#include <cmath>
+#include <algorithm>
+#include "HyperLogLog.h"
+#include "BasicHashMap.h"
+
+//Constructor
+HyperLogLog::HyperLogLog(unsigned long precision) : precision(precision), registerCount(1UL << precision) {
+    registers = new uint8_t[registerCount];
+    std::fill(registers, registers + registerCount, 0);
+}
+
+// Destructor
+HyperLogLog::~HyperLogLog() {
+    delete[] registers;
+}
+
+//the word hash every table uses, mixed so the top bits, which pick the register, are well spread
+uint64_t HyperLogLog::hashFunction(const std::string& key) {
+    return mixHash(KeyHash<std::string>()(key));
+}
+
+void HyperLogLog::add(const std::string& key) {
+    if (key.empty()) return;
+
+    uint64_t hash = hashFunction(key);
+    unsigned long index = hash >> (64 - precision); // top bits pick the register
+    uint64_t rest = hash << precision;
+    uint8_t rank = rest == 0 ? (uint8_t)(64 - precision + 1) : (uint8_t)(__builtin_clzll(rest) + 1);
+    if (rank > registers[index]) {
+        registers[index] = rank;
+    }
+}
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+#pragma omp simd
+    for (unsigned long i = 0; i < registerCount; i++) {
+        registers[i] = std::max(registers[i], other.registers[i]);
+    }
+}
+
+double HyperLogLog::estimate() const {
+    double m = (double)registerCount;
+    double alpha = 0.7213 / (1.0 + 1.079 / m);
+    double sum = 0;
+    unsigned long zeros = 0;
+    for (unsigned long i = 0; i < registerCount; i++) {
+        sum += std::ldexp(1.0, -registers[i]);
+        if (registers[i] == 0) zeros++;
+    }
+
+    double raw = alpha * m * m / sum;
+    // Small cardinalities: linear counting on the empty registers is more accurate
+    if (raw <= 2.5 * m && zeros > 0) {
+        return m * std::log(m / (double)zeros);
+    }
+    return raw;
+}
@@ -0,0 +1,24 @@
+#ifndef PARALLELPROCESSING_HYPERLOGLOG_H
+#define PARALLELPROCESSING_HYPERLOGLOG_H
+
+#include <string>
+#include <cstdint>
+
+// Distinct-count estimator with 2^precision one-byte registers.
+// Standard error is about 1.04 / sqrt(2^precision); two estimators merge with an elementwise max.
+class HyperLogLog {
+public:
+    uint8_t* registers;
+    unsigned long precision;
+    unsigned long registerCount;
+
+    explicit HyperLogLog(unsigned long precision);
+    ~HyperLogLog();
+    void add(const std::string& key);
+    void merge(const HyperLogLog& other);
+    double estimate() const;
+
+    static uint64_t hashFunction(const std::string& key);
+};
+
+#endif //PARALLELPROCESSING_HYPERLOGLOG_H
@@ -0,0 +1,19 @@
+#include "NGramTable.h"
+
+// FNV-style mix of each ID followed by the murmur finalizer
+unsigned long KeyHash<NGramKey>::operator()(const NGramKey& key) const {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (uint32_t id : key.ids) {
+        hash ^= id;
+        hash *= 0x100000001B3ULL;
+    }
+    return mixHash(hash);
+}
+
+//counts `key` into `table`, doubling the table once it holds more n-grams than buckets;
+//`distinct` is the table's n-gram count so far
+void addNGram(NGramTable& table, unsigned long& distinct, const NGramKey& key, uint64_t count) {
+    if (table.add(key, count) && ++distinct > table.tableSize) {
+        table.rehash(table.tableSize * 2);
+    }
+}
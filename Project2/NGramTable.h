@@ -0,0 +1,29 @@
+#ifndef PARALLELPROCESSING_NGRAMTABLE_H
+#define PARALLELPROCESSING_NGRAMTABLE_H
+
+#include <cstdint>
+#include "BasicHashMap.h"
+#include "NodeArena.h"
+
+const unsigned long MAX_NGRAM = 5;
+
+// Key policy for phrase counts: the n word IDs of an n-gram, IDs past n left at 0.
+// A key is a fixed 20 bytes, so memory grows with the number of distinct n-grams
+// and not with the length of the words in them.
+struct NGramKey {
+    uint32_t ids[MAX_NGRAM] = {};
+
+    bool operator==(const NGramKey& other) const = default;
+};
+
+template <>
+struct KeyHash<NGramKey> {
+    unsigned long operator()(const NGramKey& key) const;
+};
+
+// Phrase counts: occurrences summed per n-gram, on huge pages when they are on
+using NGramTable = BasicHashMap<NGramKey, uint64_t, KeyHash<NGramKey>, SumCombine, LargePageStorage>;
+
+void addNGram(NGramTable& table, unsigned long& distinct, const NGramKey& key, uint64_t count);
+
+#endif //PARALLELPROCESSING_NGRAMTABLE_H
@@ -0,0 +1,104 @@
+#ifndef PARALLELPROCESSING_NODEARENA_H
+#define PARALLELPROCESSING_NODEARENA_H
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <algorithm>
+#include <utility>
+#include "HugePages.h"
+
+const unsigned long ARENA_CHUNK_BYTES = 2UL * 1024 * 1024; // one huge page per chunk
+
+// Bump allocator for hash nodes in huge-page backed chunks, used by a table when huge
+// pages are on. Safe to call from several threads at once (merging into the main
+// table does). Nodes are never freed one by one; the arena destroys them all at the end.
+template <typename Node>
+class NodeArena {
+public:
+    //Constructor
+    NodeArena() : nodesPerChunk(ARENA_CHUNK_BYTES / sizeof(Node)) {
+        current.store(newChunk(nullptr));
+    }
+
+    // Destructor: runs every node's destructor, then gives the chunks back
+    ~NodeArena() {
+        Chunk* chunk = current.load();
+        while (chunk != nullptr) {
+            unsigned long constructed = std::min(chunk->used.load(), nodesPerChunk);
+            for (unsigned long i = 0; i < constructed; i++) {
+                chunk->nodes[i].~Node();
+            }
+            Chunk* previous = chunk->previous;
+            releaseLarge(chunk->nodes, ARENA_CHUNK_BYTES, chunk->mapped);
+            delete chunk;
+            chunk = previous;
+        }
+    }
+
+    /**
+     * Claims the next slot with an atomic increment. The thread that runs a chunk
+     * dry takes the lock and installs a fresh chunk, unless another thread already has.
+     */
+    template <typename... Args>
+    Node* allocate(Args&&... args) {
+        while (true) {
+            Chunk* chunk = current.load(std::memory_order_acquire);
+            unsigned long slot = chunk->used.fetch_add(1, std::memory_order_relaxed);
+            if (slot < nodesPerChunk) {
+                return new (&chunk->nodes[slot]) Node(std::forward<Args>(args)...);
+            }
+            std::lock_guard<std::mutex> guard(refillLock);
+            if (current.load(std::memory_order_relaxed) == chunk) {
+                current.store(newChunk(chunk), std::memory_order_release);
+            }
+        }
+    }
+
+private:
+    struct Chunk {
+        Node* nodes;
+        std::atomic<unsigned long> used;
+        bool mapped;
+        Chunk* previous;
+    };
+
+    std::atomic<Chunk*> current;
+    std::mutex refillLock;
+    unsigned long nodesPerChunk;
+
+    Chunk* newChunk(Chunk* previous) {
+        Chunk* chunk = new Chunk;
+        chunk->nodes = (Node*)allocateLarge(ARENA_CHUNK_BYTES, chunk->mapped);
+        chunk->used.store(0);
+        chunk->previous = previous;
+        return chunk;
+    }
+};
+
+// Storage policy for BasicHashMap: slot arrays through allocateLarge, and nodes from an
+// arena while huge pages are on
+struct LargePageStorage {
+    static void* allocateSlots(unsigned long bytes, bool& mapped) {
+        return allocateLarge(bytes, mapped);
+    }
+    static void releaseSlots(void* slots, unsigned long bytes, bool mapped) {
+        releaseLarge(slots, bytes, mapped);
+    }
+
+    template <typename Node>
+    struct Nodes {
+        NodeArena<Node>* arena = hugePagesEnabled() ? new NodeArena<Node>() : nullptr;
+
+        ~Nodes() {
+            delete arena; // destroys the arena's nodes, if it had any
+        }
+        template <typename... Args>
+        Node* create(Args&&... args) {
+            return arena != nullptr ? arena->allocate(std::forward<Args>(args)...) : new Node(std::forward<Args>(args)...);
+        }
+        bool ownsNodes() const { return arena != nullptr; }
+    };
+};
+
+#endif //PARALLELPROCESSING_NODEARENA_H
@@ -0,0 +1,332 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "HashNode.h"
+#include "HashMap.h"
+#include "WordCount.h"
+#include "Utils.h"
+#include "Pipeline.h"
+#include "BlockReader.h"
+#include "CompressedInput.h"
+
+using namespace std;
+
+//"R,T,A" reader, tokenizer and aggregator thread counts
+bool parsePipelineConfig(const string& text, PipelineConfig& config) {
+    stringstream counts(text);
+    char comma1;
+    char comma2;
+    if (!(counts >> config.readers >> comma1 >> config.tokenizers >> comma2 >> config.aggregators) ||
+        comma1 != ',' || comma2 != ',') {
+        return false;
+    }
+    return config.readers > 0 && config.tokenizers > 0 && config.aggregators > 0;
+}
+
+/**
+ * Reads the bytes [start, end) into `block`, trimmed to whole words: a word belongs to
+ * the block holding its first byte, so a word cut at `start` is left to the previous
+ * block and a word cut at `end` is finished by reading on.
+ * Returns false if the file ended early or could not be read.
+ */
+bool readBlock(ifstream& file, unsigned long start, unsigned long end, unsigned long fileSize, string& block) {
+    block.assign(end - start, '\0');
+    file.clear();
+    file.seekg(start);
+    file.read(&block[0], end - start);
+    if ((unsigned long)file.gcount() != end - start) {
+        return false;
+    }
+
+    unsigned long first = 0;
+    if (start > 0) {
+        char previous;
+        file.seekg(start - 1);
+        file.get(previous);
+        if (!isspace((unsigned char)previous)) {
+            while (first < block.size() && !isspace((unsigned char)block[first])) {
+                first++;
+            }
+        }
+    }
+
+    if (first < block.size() && !isspace((unsigned char)block.back()) && end < fileSize) {
+        file.clear();
+        file.seekg(end);
+        char c;
+        while (file.get(c) && !isspace((unsigned char)c)) {
+            block += c;
+        }
+    }
+    block.erase(0, first);
+    return true;
+}
+
+/**
+ * Staged word count: reader threads -> tokenizer threads -> aggregator threads.
+ * Steps:
+ * 1. Readers claim fixed-size blocks of the file from a shared counter and push
+ *    them into one bounded MPMC ring
+ * 2. Tokenizers pop blocks, split and normalize the words, hash each once and
+ *    append it to a batch for the aggregator that owns that hash. A full batch
+ *    goes into that tokenizer's SPSC ring for the aggregator
+ * 3. Each aggregator owns a disjoint set of words in its own table and drains
+ *    its rings, one per tokenizer, round-robin
+ * A full ring makes its producer wait, so a fast stage cannot run ahead of a slow
+ * one by more than the ring sizes. The tables need no merge, only one sort.
+ * For gzip or zstd input the readers are decoders (see decompressInput).
+ * Returns false if the input could not be read or decoded.
+ */
+bool dispatchPipeline(const PipelineConfig& config, const string& fileName, const string& outputName) {
+    ifstream file(fileName);
+    if (!file) {
+        cerr << "Error opening input file " << fileName << "." << endl;
+        return false;
+    }
+    unsigned long fileSize = getFileLength(file);
+    InputFormat format = detectFormat(fileName);
+    unsigned long blockCount = (fileSize + PIPELINE_BLOCK_BYTES - 1) / PIPELINE_BLOCK_BYTES;
+
+    MpmcRing<string*> blocks(BLOCK_RING_SLOTS);
+    vector<SpscRing<TokenBatch*>*> batchRings; // [tokenizer * aggregators + aggregator]
+    for (int i = 0; i < config.tokenizers * config.aggregators; i++) {
+        batchRings.push_back(new SpscRing<TokenBatch*>(BATCH_RING_SLOTS));
+    }
+    atomic<unsigned long> nextBlock(0);
+    atomic<int> activeReaders(config.readers);
+    atomic<int> activeTokenizers(config.tokenizers);
+    vector<StageStalls> readerStalls(config.readers);
+    vector<StageStalls> tokenizerStalls(config.tokenizers);
+    vector<StageStalls> aggregatorStalls(config.aggregators);
+
+    // Vocabulary estimate split across the aggregators
+    unsigned long mainTableSize = 0;
+    unsigned long threadTableSize = 0;
+    if (format == InputFormat::Plain) {
+        estimateTableSizes(fileName, config.tokenizers, mainTableSize, threadTableSize);
+    } else {
+        // Sampling needs text; guess from the compressed size (about one new word per 16 bytes)
+        mainTableSize = max(1UL << 16, fileSize / 16);
+    }
+    vector<HashMap*> tables;
+    for (int a = 0; a < config.aggregators; a++) {
+        tables.push_back(new HashMap(max(100UL, mainTableSize / config.aggregators)));
+    }
+
+    auto begin = chrono::steady_clock::now();
+    vector<thread> threads;
+    // A block reader keeps its own queue of reads in flight, so it replaces the reader threads
+    bool blockReader = config.asyncReads || config.directReads;
+    bool decoded = true;
+    atomic<bool> readFailed(false); // a reader could not open the file or hit a short read
+    atomic<unsigned long> decoderStalls(0);
+    if (format != InputFormat::Plain) {
+        cout << "Decompressing " << formatName(format) << " input with up to " << config.readers << " threads" << endl;
+        activeReaders.store(1);
+        threads.emplace_back([&]() {
+            decoded = decompressInput(fileName, format, config.readers, [&](string* text) {
+                while (!blocks.tryPush(text)) {
+                    decoderStalls.fetch_add(1, memory_order_relaxed);
+                    this_thread::yield();
+                }
+            });
+            activeReaders.fetch_sub(1, memory_order_release);
+        });
+    } else if (blockReader) {
+        activeReaders.store(1);
+        threads.emplace_back([&]() {
+            BlockReader reader(PIPELINE_BLOCK_BYTES, config.queueDepth);
+            bool opened = reader.open(fileName, config.asyncReads, config.directReads);
+            if (opened) {
+                cout << "Reading with " << reader.backend() << endl;
+                string chunk;
+                while (reader.next(chunk)) {
+                    string* text = new string(std::move(chunk));
+                    while (!blocks.tryPush(text)) {
+                        readerStalls[0].blocked++;
+                        this_thread::yield();
+                    }
+                }
+            }
+            if (!opened || reader.failed()) {
+                readFailed.store(true);
+            }
+            activeReaders.fetch_sub(1, memory_order_release);
+        });
+    }
+    for (int r = 0; r < config.readers && !blockReader && format == InputFormat::Plain; r++) {
+        threads.emplace_back([&, r]() {
+            ifstream readerFile(fileName, ios::binary);
+            unsigned long block;
+            while ((block = nextBlock.fetch_add(1)) < blockCount) {
+                unsigned long start = block * PIPELINE_BLOCK_BYTES;
+                unsigned long end = min(fileSize, start + PIPELINE_BLOCK_BYTES);
+                string* text = new string;
+                if (!readBlock(readerFile, start, end, fileSize, *text)) {
+                    delete text;
+                    readFailed.store(true);
+                    break;
+                }
+                while (!blocks.tryPush(text)) {
+                    readerStalls[r].blocked++;
+                    this_thread::yield();
+                }
+            }
+            activeReaders.fetch_sub(1, memory_order_release);
+        });
+    }
+
+    for (int t = 0; t < config.tokenizers; t++) {
+        threads.emplace_back([&, t]() {
+            vector<TokenBatch*> pending(config.aggregators);
+            for (int a = 0; a < config.aggregators; a++) {
+                pending[a] = new TokenBatch;
+            }
+            auto send = [&](int a) {
+                while (!batchRings[t * config.aggregators + a]->tryPush(pending[a])) {
+                    tokenizerStalls[t].blocked++;
+                    this_thread::yield();
+                }
+                pending[a] = new TokenBatch;
+            };
+
+            string* text;
+            while (true) {
+                bool finished = activeReaders.load(memory_order_acquire) == 0; // read before popping
+                if (!blocks.tryPop(text)) {
+                    if (finished) {
+                        break;
+                    }
+                    tokenizerStalls[t].starved++;
+                    this_thread::yield();
+                    continue;
+                }
+
+                // Split on whitespace like operator>> does
+                unsigned long wordStart = string::npos;
+                for (unsigned long i = 0; i <= text->size(); i++) {
+                    bool space = i == text->size() || isspace((unsigned char)(*text)[i]);
+                    if (!space && wordStart == string::npos) {
+                        wordStart = i;
+                    } else if (space && wordStart != string::npos) {
+                        string normalized = normalizeWord(text->substr(wordStart, i - wordStart));
+                        wordStart = string::npos;
+                        if (normalized.empty()) continue;
+                        unsigned long hash = HashMap::rawHash(normalized);
+                        int a = ownerOf(hash, config.aggregators);
+                        pending[a]->words.push_back(std::move(normalized));
+                        pending[a]->hashes.push_back(hash);
+                        if (pending[a]->words.size() == PIPELINE_TOKEN_BATCH) {
+                            send(a);
+                        }
+                    }
+                }
+                delete text;
+            }
+            for (int a = 0; a < config.aggregators; a++) {
+                if (!pending[a]->words.empty()) {
+                    send(a);
+                }
+                delete pending[a];
+            }
+            activeTokenizers.fetch_sub(1, memory_order_release);
+        });
+    }
+
+    for (int a = 0; a < config.aggregators; a++) {
+        threads.emplace_back([&, a]() {
+            HashMap& table = *tables[a];
+            TokenBatch* batch;
+            while (true) {
+                bool finished = activeTokenizers.load(memory_order_acquire) == 0; // read before draining
+                bool found = false;
+                for (int t = 0; t < config.tokenizers; t++) {
+                    while (batchRings[t * config.aggregators + a]->tryPop(batch)) {
+                        table.insertBatchHashed(batch->words.data(), batch->hashes.data(), batch->words.size());
+                        delete batch;
+                        found = true;
+                    }
+                }
+                if (finished && !found) {
+                    break;
+                }
+                if (!found) {
+                    aggregatorStalls[a].starved++;
+                    this_thread::yield();
+                }
+            }
+        });
+    }
+
+    for (thread& worker : threads) {
+        worker.join();
+    }
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - begin);
+    readerStalls[0].blocked += decoderStalls.load();
+    if (!decoded || readFailed.load()) {
+        for (HashMap* table : tables) {
+            delete table;
+        }
+        for (auto* ring : batchRings) {
+            delete ring;
+        }
+        if (!decoded && format == InputFormat::Gzip && config.readers > 1) {
+            // A decoder guessed a member start wrong; one decoder never has to guess
+            cout << "gzip members did not line up between decoders; decoding again with one thread" << endl;
+            PipelineConfig sequential = config;
+            sequential.readers = 1;
+            return dispatchPipeline(sequential, fileName, outputName);
+        }
+        if (readFailed.load() && blockReader) {
+            // io_uring or O_DIRECT reads can fail where plain reads work; whatever was counted is dropped
+            cout << "Block reads of " << fileName << " failed; reading again with plain reads" << endl;
+            PipelineConfig plain = config;
+            plain.asyncReads = false;
+            plain.directReads = false;
+            return dispatchPipeline(plain, fileName, outputName);
+        }
+        cerr << (decoded ? "Could not read " : "Could not decode ") << fileName << "." << endl;
+        return false;
+    }
+
+    // Aggregators own disjoint words, so their tables are written out together
+    vector<WordCount*> wordCounts;
+    for (HashMap* table : tables) {
+        for (unsigned long i = 0; i < table->tableSize; i++) {
+            for (HashNode* node = table->table[i]; node != nullptr; node = node->next) {
+                wordCounts.push_back(new WordCount(node->key, node->value));
+            }
+        }
+        delete table;
+    }
+    if (!wordCounts.empty()) {
+        mergeSort(wordCounts.data(), 0, (int)wordCounts.size() - 1);
+    }
+    ofstream outFile(outputName);
+    for (WordCount* wordCount : wordCounts) {
+        outFile << wordCount->word << ": " << wordCount->count << endl;
+        delete wordCount;
+    }
+    outFile.close();
+    for (auto* ring : batchRings) {
+        delete ring;
+    }
+
+    // Stalls show which stage to give more threads: starved stages wait on the one before
+    auto total = [](const vector<StageStalls>& stalls, bool blocked) {
+        unsigned long sum = 0;
+        for (const StageStalls& stall : stalls) {
+            sum += blocked ? stall.blocked : stall.starved;
+        }
+        return sum;
+    };
+    cout << "Pipeline " << config.readers << "," << config.tokenizers << "," << config.aggregators
+         << " counted in " << elapsed.count() << " ms" << endl;
+    cout << "  readers blocked " << total(readerStalls, true)
+         << ", tokenizers starved " << total(tokenizerStalls, false) << " / blocked " << total(tokenizerStalls, true)
+         << ", aggregators starved " << total(aggregatorStalls, false) << endl;
+    return true;
+}
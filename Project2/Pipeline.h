@@ -0,0 +1,42 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "HashMap.h"
+#include "RingBuffer.h"
+
+using namespace std;
+
+#ifndef PARALLELPROCESSING_PIPELINE_H
+#define PARALLELPROCESSING_PIPELINE_H
+
+const unsigned long PIPELINE_BLOCK_BYTES = 1 << 20;  // bytes a reader hands on at a time
+const unsigned long PIPELINE_TOKEN_BATCH = 512;      // words per tokenizer -> aggregator batch
+const unsigned long BLOCK_RING_SLOTS = 16;           // blocks in flight between readers and tokenizers
+const unsigned long BATCH_RING_SLOTS = 64;           // batches in flight per tokenizer/aggregator pair
+
+struct PipelineConfig {
+    int readers = 1;
+    int tokenizers = 4;
+    int aggregators = 4;
+    bool asyncReads = false;          // one reader keeping queueDepth reads in flight with io_uring
+    bool directReads = false;         // O_DIRECT, bypassing the page cache
+    unsigned long queueDepth = 32;
+};
+
+// Normalized words bound for one aggregator, with their raw hashes
+struct TokenBatch {
+    vector<string> words;
+    vector<unsigned long> hashes;
+};
+
+// Times a stage found its input ring empty or its output ring full
+struct StageStalls {
+    unsigned long starved = 0;
+    unsigned long blocked = 0;
+};
+
+bool parsePipelineConfig(const string& text, PipelineConfig& config);
+bool readBlock(ifstream& file, unsigned long start, unsigned long end, unsigned long fileSize, string& block);
+bool dispatchPipeline(const PipelineConfig& config, const string& fileName, const string& outputName);
+
+#endif //PARALLELPROCESSING_PIPELINE_H
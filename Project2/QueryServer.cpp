@@ -0,0 +1,299 @@
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <csignal>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "CountIndex.h"
+#include "FrozenCounts.h"
+#include "Utils.h"
+#include "QueryServer.h"
+
+using namespace std;
+
+/*
+ * Line protocol, one command per line. Every reply ends with a line holding a single ".".
+ *   get WORD              -> "WORD: COUNT" (0 if never seen)
+ *   mget WORD WORD ...    -> one "WORD: COUNT" line per word, looked up as a batch
+ *   prefix TEXT [LIMIT]   -> "matches: N", then up to LIMIT words starting with TEXT, alphabetical
+ *   top K                 -> the K most frequent words
+ *   stats                 -> lookups served and their p50 / p99 / max time
+ *   quit                  -> closes the session
+ * Words are normalized the same way as when counting.
+ */
+
+void appendCount(string& reply, string_view word, uint64_t count) {
+    reply.append(word);
+    reply += ": ";
+    reply += to_string(count);
+    reply += '\n';
+}
+
+//histogram bucket of a time: exact below LATENCY_SUB_BUCKETS, then LATENCY_SUB_BUCKETS per power of two
+unsigned long latencyBucket(uint64_t nanos) {
+    if (nanos < LATENCY_SUB_BUCKETS) {
+        return nanos;
+    }
+    int exponent = 63 - __builtin_clzll(nanos); // at least 3
+    uint64_t mantissa = (nanos >> (exponent - 3)) & (LATENCY_SUB_BUCKETS - 1);
+    return (exponent - 2) * LATENCY_SUB_BUCKETS + mantissa;
+}
+
+//largest time that falls in `bucket`
+uint64_t latencyBucketTop(unsigned long bucket) {
+    if (bucket < LATENCY_SUB_BUCKETS) {
+        return bucket;
+    }
+    int exponent = bucket / LATENCY_SUB_BUCKETS + 2;
+    uint64_t mantissa = bucket % LATENCY_SUB_BUCKETS;
+    uint64_t width = 1ULL << (exponent - 3);
+    return (LATENCY_SUB_BUCKETS + mantissa) * width + (width - 1);
+}
+
+void recordLookup(QueryStats& stats, uint64_t nanos) {
+    stats.buckets[latencyBucket(nanos)]++;
+    stats.lookups++;
+    stats.maxNanos = max(stats.maxNanos, nanos);
+}
+
+//nanosecond percentile of the recorded lookups, rounded up to its bucket's top (never past the max)
+uint64_t percentile(const QueryStats& stats, double fraction) {
+    if (stats.lookups == 0) {
+        return 0;
+    }
+    uint64_t index = min(stats.lookups - 1, (uint64_t)(fraction * stats.lookups));
+    uint64_t seen = 0;
+    for (unsigned long bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        seen += stats.buckets[bucket];
+        if (seen > index) {
+            return min(stats.maxNanos, latencyBucketTop(bucket));
+        }
+    }
+    return stats.maxNanos;
+}
+
+//fills `reply` for one command; returns false when the client asked to quit
+bool answerQuery(const FrozenCounts& table, const string& line, string& reply, QueryStats& stats) {
+    istringstream words(line);
+    string command;
+    words >> command;
+
+    if (command == "get") {
+        string word;
+        words >> word;
+        string normalized = normalizeWord(word);
+        auto begin = chrono::steady_clock::now();
+        uint64_t count = table.get(normalized);
+        auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin);
+        recordLookup(stats, elapsed.count());
+        appendCount(reply, normalized, count);
+    } else if (command == "mget") {
+        vector<string> normalized;
+        string word;
+        while (words >> word) {
+            normalized.push_back(normalizeWord(word));
+        }
+        vector<string_view> views(normalized.begin(), normalized.end());
+        vector<uint64_t> counts;
+        auto begin = chrono::steady_clock::now();
+        table.getBatch(views, counts);
+        auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin);
+        for (unsigned long i = 0; i < views.size(); i++) {
+            recordLookup(stats, elapsed.count() / views.size());
+            appendCount(reply, views[i], counts[i]);
+        }
+    } else if (command == "prefix") {
+        string prefix;
+        unsigned long limit = DEFAULT_PREFIX_LIMIT;
+        words >> prefix >> limit;
+        prefix = normalizeWord(prefix);
+        auto range = table.prefixRange(prefix);
+        reply += "matches: " + to_string(range.second - range.first) + "\n";
+        for (unsigned long i = range.first; i < range.second && i < range.first + limit; i++) {
+            appendCount(reply, table.key(i), table.count(i));
+        }
+    } else if (command == "top") {
+        unsigned long k = 10;
+        words >> k;
+        for (unsigned long rank = 0; rank < k && rank < table.size(); rank++) {
+            unsigned long i = table.ranked(rank);
+            appendCount(reply, table.key(i), table.count(i));
+        }
+    } else if (command == "stats") {
+        reply += "lookups: " + to_string(stats.lookups) + "\n";
+        reply += "p50 ns: " + to_string(percentile(stats, 0.50)) + "\n";
+        reply += "p99 ns: " + to_string(percentile(stats, 0.99)) + "\n";
+        reply += "max ns: " + to_string(stats.maxNanos) + "\n";
+    } else if (command == "quit") {
+        return false;
+    } else if (!command.empty()) {
+        reply += "error: unknown command " + command + "\n";
+    } else {
+        return true; // blank line, no reply
+    }
+    reply += ".\n";
+    return true;
+}
+
+//writes all of `data`, retrying short writes; false if the other end went away
+bool writeAll(int fd, const string& data) {
+    unsigned long written = 0;
+    while (written < data.size()) {
+        ssize_t result = write(fd, data.data() + written, data.size() - written);
+        if (result <= 0) {
+            return false;
+        }
+        written += result;
+    }
+    return true;
+}
+
+/**
+ * Runs one session until end of input or "quit".
+ * Every complete line in a read is answered before the replies go out in one
+ * write, so a client that pipelines many queries pays one system call per read
+ * instead of one per query.
+ */
+void serveStream(const FrozenCounts& table, int inFd, int outFd) {
+    QueryStats stats;
+    string pending;
+    string reply;
+    vector<char> buffer(QUERY_READ_SIZE);
+    bool open = true;
+    while (open) {
+        ssize_t got = read(inFd, buffer.data(), buffer.size());
+        if (got <= 0) {
+            break;
+        }
+        pending.append(buffer.data(), got);
+
+        unsigned long lineStart = 0;
+        unsigned long newline;
+        while (open && (newline = pending.find('\n', lineStart)) != string::npos) {
+            open = answerQuery(table, pending.substr(lineStart, newline - lineStart), reply, stats);
+            lineStart = newline + 1;
+        }
+        pending.erase(0, lineStart);
+        if (!writeAll(outFd, reply)) {
+            break;
+        }
+        reply.clear();
+    }
+}
+
+//one connected client; the accept loop owns the descriptor and closes it after joining the thread,
+//so a hang-up from reapSessions can never reach a reused descriptor
+struct Session {
+    int client;
+    atomic<bool> done{false};
+    thread worker;
+};
+
+//joins and closes the sessions whose client has gone; with `all`, hangs up on the rest first and waits for them
+void reapSessions(list<unique_ptr<Session>>& sessions, bool all) {
+    for (auto it = sessions.begin(); it != sessions.end();) {
+        Session& session = **it;
+        if (all && !session.done.load()) {
+            shutdown(session.client, SHUT_RDWR); // wakes the read in serveStream
+        }
+        if (all || session.done.load()) {
+            session.worker.join();
+            close(session.client);
+            it = sessions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+/**
+ * Accepts clients on a Unix socket until accept fails, one thread per client;
+ * the table is read-only so they share it.
+ * Every session thread is joined before this returns, so none outlives the table.
+ */
+bool serveSocket(const FrozenCounts& table, const string& socketPath) {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        cerr << "Socket path too long: " << socketPath << endl;
+        return false;
+    }
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath.c_str());
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socketPath.c_str());
+    if (listener < 0 || ::bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 64) != 0) {
+        cerr << "Could not listen on " << socketPath << ": " << strerror(errno) << endl;
+        return false;
+    }
+    signal(SIGPIPE, SIG_IGN); // a client hanging up must not end the server
+    cerr << "Listening on " << socketPath << endl;
+
+    list<unique_ptr<Session>> sessions;
+    while (true) {
+        int client = accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        reapSessions(sessions, false);
+        sessions.push_back(make_unique<Session>());
+        Session* session = sessions.back().get();
+        session->client = client;
+        session->worker = thread([&table, session]() {
+            serveStream(table, session->client, session->client);
+            shutdown(session->client, SHUT_RDWR); // the client sees end of stream now; the descriptor is closed when reaped
+            session->done.store(true);
+        });
+    }
+    cerr << "Stopped accepting on " << socketPath << ": " << strerror(errno) << endl;
+    close(listener);
+    reapSessions(sessions, true);
+    return false;
+}
+
+/**
+ * Query server mode.
+ * Steps:
+ * 1. Load the counts from the index, or count the input files once
+ * 2. Freeze them into the read-optimized layout
+ * 3. Answer queries on stdin/stdout, or on a Unix socket when one is given
+ * Progress goes to stderr so stdout carries only the protocol; "ready" marks the start.
+ */
+bool dispatchServer(int numThreads, const string& indexPath, const vector<string>& fileNames, const string& socketPath) {
+    auto begin = chrono::steady_clock::now();
+    vector<pair<string, uint64_t>> entries;
+    if (!indexPath.empty()) {
+        CountIndex index;
+        if (!index.open(indexPath) || !index.verify()) {
+            cerr << "Could not load index " << indexPath << "." << endl;
+            return false;
+        }
+        entries.reserve(index.size());
+        for (unsigned long i = 0; i < index.size(); i++) {
+            entries.emplace_back(string(index.key(i)), index.count(i));
+        }
+    } else {
+        collectSortedCounts(numThreads, fileNames, entries);
+    }
+    FrozenCounts table(entries);
+    entries.clear();
+    entries.shrink_to_fit();
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - begin);
+    cerr << "Loaded " << table.size() << " words in " << elapsed.count() << " ms" << endl;
+
+    if (!socketPath.empty()) {
+        return serveSocket(table, socketPath);
+    }
+    cout << "ready " << table.size() << endl;
+    serveStream(table, STDIN_FILENO, STDOUT_FILENO);
+    return true;
+}
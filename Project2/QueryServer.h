@@ -0,0 +1,32 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "FrozenCounts.h"
+
+using namespace std;
+
+#ifndef PARALLELPROCESSING_QUERYSERVER_H
+#define PARALLELPROCESSING_QUERYSERVER_H
+
+const unsigned long QUERY_READ_SIZE = 64 * 1024;  // bytes read from a client at a time
+const unsigned long DEFAULT_PREFIX_LIMIT = 100;   // most words a prefix query lists unless told otherwise
+
+const unsigned long LATENCY_SUB_BUCKETS = 8;                          // buckets per power of two, so within 1/8 of the time
+const unsigned long LATENCY_BUCKETS = (64 - 2) * LATENCY_SUB_BUCKETS;  // covers every uint64_t nanosecond count
+
+//lookup times as a log-bucket histogram: fixed size however long the session runs
+struct QueryStats {
+    uint64_t lookups = 0;
+    uint64_t maxNanos = 0;
+    uint64_t buckets[LATENCY_BUCKETS] = {};
+};
+
+void recordLookup(QueryStats& stats, uint64_t nanos);
+uint64_t percentile(const QueryStats& stats, double fraction);
+
+bool answerQuery(const FrozenCounts& table, const string& line, string& reply, QueryStats& stats);
+void serveStream(const FrozenCounts& table, int inFd, int outFd);
+bool serveSocket(const FrozenCounts& table, const string& socketPath);
+bool dispatchServer(int numThreads, const string& indexPath, const vector<string>& fileNames, const string& socketPath);
+
+#endif //PARALLELPROCESSING_QUERYSERVER_H
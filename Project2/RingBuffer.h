@@ -0,0 +1,129 @@
+#ifndef PARALLELPROCESSING_RINGBUFFER_H
+#define PARALLELPROCESSING_RINGBUFFER_H
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+const unsigned long CACHE_LINE_BYTES = 64;
+
+// Bounded single-producer single-consumer ring. Capacity is rounded up to a power of two.
+// Each side owns one index and only reads the other's, so no compare-and-swap is needed.
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(unsigned long capacity) {
+        unsigned long size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        slots.reset(new T[size]);
+        mask = size - 1;
+        head.store(0);
+        tail.store(0);
+    }
+
+    //false when full; the producer backs off and retries
+    bool tryPush(const T& item) {
+        unsigned long position = tail.load(std::memory_order_relaxed);
+        if (position - head.load(std::memory_order_acquire) > mask) {
+            return false;
+        }
+        slots[position & mask] = item;
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    //false when empty
+    bool tryPop(T& item) {
+        unsigned long position = head.load(std::memory_order_relaxed);
+        if (position == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = slots[position & mask];
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::unique_ptr<T[]> slots;
+    unsigned long mask;
+    alignas(CACHE_LINE_BYTES) std::atomic<unsigned long> head; // next slot to pop, written by the consumer
+    alignas(CACHE_LINE_BYTES) std::atomic<unsigned long> tail; // next slot to fill, written by the producer
+};
+
+// Bounded multi-producer multi-consumer ring (Vyukov's design). Every cell carries a
+// sequence number that says whether it is ready to be filled or to be emptied at a
+// given lap, so producers and consumers only race on their own index.
+template <typename T>
+class MpmcRing {
+public:
+    explicit MpmcRing(unsigned long capacity) {
+        unsigned long size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        cells.reset(new Cell[size]);
+        mask = size - 1;
+        for (unsigned long i = 0; i < size; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        enqueuePosition.store(0);
+        dequeuePosition.store(0);
+    }
+
+    bool tryPush(const T& item) {
+        Cell* cell;
+        unsigned long position = enqueuePosition.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &cells[position & mask];
+            long difference = (long)cell->sequence.load(std::memory_order_acquire) - (long)position;
+            if (difference == 0) {
+                if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false; // full
+            } else {
+                position = enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = item;
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& item) {
+        Cell* cell;
+        unsigned long position = dequeuePosition.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &cells[position & mask];
+            long difference = (long)cell->sequence.load(std::memory_order_acquire) - (long)(position + 1);
+            if (difference == 0) {
+                if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false; // empty
+            } else {
+                position = dequeuePosition.load(std::memory_order_relaxed);
+            }
+        }
+        item = cell->value;
+        cell->sequence.store(position + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    struct Cell {
+        std::atomic<unsigned long> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    unsigned long mask;
+    alignas(CACHE_LINE_BYTES) std::atomic<unsigned long> enqueuePosition;
+    alignas(CACHE_LINE_BYTES) std::atomic<unsigned long> dequeuePosition;
+};
+
+#endif //PARALLELPROCESSING_RINGBUFFER_H
@@ -0,0 +1,57 @@
+#include "SpaceSaving.h"
+
+//Constructor
+SpaceSaving::SpaceSaving(unsigned long capacity) : capacity(capacity) {
+    heap.reserve(capacity);
+    positions.reserve(capacity * 2);
+}
+
+void SpaceSaving::insert(const std::string& word) {
+    if (word.empty() || capacity == 0) return;
+
+    auto found = positions.find(word);
+    if (found != positions.end()) {
+        // Counts only grow, so the entry can only need to move down the heap
+        heap[found->second].count++;
+        siftDown(found->second);
+        return;
+    }
+
+    if (heap.size() < capacity) {
+        // Filling up: a new entry with count 1 is never above a parent, so it stays at the bottom
+        heap.push_back({word, 1});
+        unsigned long index = heap.size() - 1;
+        positions[word] = index;
+        while (index > 0 && heap[(index - 1) / 2].count > heap[index].count) {
+            swapEntries(index, (index - 1) / 2);
+            index = (index - 1) / 2;
+        }
+        return;
+    }
+
+    // Full: the new word takes over the smallest slot and inherits its count
+    positions.erase(heap[0].word);
+    heap[0].word = word;
+    heap[0].count++;
+    positions[word] = 0;
+    siftDown(0);
+}
+
+void SpaceSaving::siftDown(unsigned long index) {
+    while (true) {
+        unsigned long smallest = index;
+        unsigned long left = index * 2 + 1;
+        unsigned long right = left + 1;
+        if (left < heap.size() && heap[left].count < heap[smallest].count) smallest = left;
+        if (right < heap.size() && heap[right].count < heap[smallest].count) smallest = right;
+        if (smallest == index) return;
+        swapEntries(index, smallest);
+        index = smallest;
+    }
+}
+
+void SpaceSaving::swapEntries(unsigned long a, unsigned long b) {
+    std::swap(heap[a], heap[b]);
+    positions[heap[a].word] = a;
+    positions[heap[b].word] = b;
+}
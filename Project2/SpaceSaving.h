@@ -0,0 +1,30 @@
+#ifndef PARALLELPROCESSING_SPACESAVING_H
+#define PARALLELPROCESSING_SPACESAVING_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+// Space-Saving heavy hitter list with a fixed number of slots.
+// Any word seen more than total / capacity times is guaranteed to be in the list.
+class SpaceSaving {
+public:
+    struct Entry {
+        std::string word;
+        uint64_t count;
+    };
+
+    std::vector<Entry> heap; // min-heap on count
+    std::unordered_map<std::string, unsigned long> positions; // word -> index in heap
+    unsigned long capacity;
+
+    explicit SpaceSaving(unsigned long capacity);
+    void insert(const std::string& word);
+
+private:
+    void siftDown(unsigned long index);
+    void swapEntries(unsigned long a, unsigned long b);
+};
+
+#endif //PARALLELPROCESSING_SPACESAVING_H
@@ -0,0 +1,149 @@
+#include <fstream>
+#include "Utf8.h"
+#include "Tokenizer.h"
+
+Tokenizer activeTokenizer;
+
+bool TokenizerRules::isDefault() const {
+    return !keepApostrophes && !keepDigits && minLength == 0 && maxLength == 0 && stopwords.empty();
+}
+
+//Constructor
+Tokenizer::Tokenizer() {
+    configure(TokenizerRules());
+}
+
+/**
+ * Compiles the rules into the lookup tables.
+ * Steps:
+ * 1. Classify every byte value and record what a kept byte folds to
+ * 2. Fill the transitions. Kept characters always lead to TOKEN_WORD, and an
+ *    apostrophe only leaves TOKEN_START when there is a word before it.
+ *    Dropped bytes leave the state alone, so "don.'t" and "don't" agree.
+ */
+void Tokenizer::configure(const TokenizerRules& newRules) {
+    rules = newRules;
+    custom = !rules.isDefault();
+
+    for (int b = 0; b < 256; b++) {
+        byteClass[b] = BYTE_DROP;
+        fold[b] = 0;
+        if (b >= 0x80) {
+            byteClass[b] = BYTE_MULTIBYTE;
+        } else if (b >= 'a' && b <= 'z') {
+            byteClass[b] = BYTE_KEEP;
+            fold[b] = (char)b;
+        } else if (b >= 'A' && b <= 'Z') {
+            byteClass[b] = BYTE_KEEP;
+            fold[b] = (char)(b - 'A' + 'a');
+        } else if (b == '-' || (rules.keepDigits && b >= '0' && b <= '9')) {
+            byteClass[b] = BYTE_KEEP;
+            fold[b] = (char)b;
+        } else if (b == '\'' && rules.keepApostrophes) {
+            byteClass[b] = BYTE_APOSTROPHE;
+        }
+    }
+
+    for (int state = 0; state < TOKEN_STATES; state++) {
+        nextState[state][BYTE_DROP] = state;
+        nextState[state][BYTE_KEEP] = TOKEN_WORD;
+        nextState[state][BYTE_APOSTROPHE] = state == TOKEN_START ? TOKEN_START : TOKEN_APOSTROPHE;
+        nextState[state][BYTE_MULTIBYTE] = state; // never taken; multibyte is reclassified first
+    }
+}
+
+const TokenizerRules& Tokenizer::getRules() const {
+    return rules;
+}
+
+//length and stopword filters; the normalized word is already non-empty
+bool Tokenizer::accept(const std::string& normalized) const {
+    if (rules.minLength > 0 || rules.maxLength > 0) {
+        unsigned long codePoints = 0;
+        for (char c : normalized) {
+            codePoints += ((unsigned char)c & 0xC0) != 0x80;
+        }
+        if (codePoints < rules.minLength || (rules.maxLength > 0 && codePoints > rules.maxLength)) {
+            return false;
+        }
+    }
+    return rules.stopwords.empty() || rules.stopwords.find(normalized) == rules.stopwords.end();
+}
+
+//the default rules are exactly the UTF-8 normalizer, with no table walk or filters
+template <>
+std::string Tokenizer::normalizeWith<false>(const std::string& word) const {
+    return normalizeUtf8Word(word);
+}
+
+template <>
+std::string Tokenizer::normalizeWith<true>(const std::string& word) const {
+    std::string normalized;
+    normalized.reserve(word.size());
+    const unsigned char* bytes = (const unsigned char*)word.data();
+    unsigned long length = word.size();
+    uint8_t state = TOKEN_START;
+
+    unsigned long i = 0;
+    while (i < length) {
+        uint8_t cls = byteClass[bytes[i]];
+        uint32_t codePoint = bytes[i];
+        unsigned long size = 1;
+        if (cls == BYTE_MULTIBYTE) {
+            size = decodeUtf8(bytes + i, length - i, codePoint);
+            if (size == 0) {
+                size = 1;
+                cls = BYTE_DROP;
+            } else if (codePoint == 0x2019) { // right single quotation mark, the typographic apostrophe
+                cls = rules.keepApostrophes ? BYTE_APOSTROPHE : BYTE_DROP;
+            } else {
+                cls = isWordCodePoint(codePoint) ? BYTE_KEEP : BYTE_DROP;
+            }
+        }
+
+        if (cls == BYTE_KEEP) {
+            if (state == TOKEN_APOSTROPHE) {
+                normalized += '\'';
+            }
+            if (codePoint < 0x80) {
+                normalized += fold[codePoint];
+            } else {
+                appendUtf8(normalized, foldCodePoint(codePoint));
+            }
+        }
+        state = nextState[state][cls];
+        i += size;
+    }
+
+    if (normalized.empty() || !accept(normalized)) {
+        return "";
+    }
+    return normalized;
+}
+
+std::string Tokenizer::normalize(const std::string& word) const {
+    return custom ? normalizeWith<true>(word) : normalizeWith<false>(word);
+}
+
+//reads whitespace separated stopwords, normalized under `rules` so they match counted words
+bool loadStopwords(const std::string& fileName, TokenizerRules& rules) {
+    std::ifstream file(fileName);
+    if (!file) {
+        return false;
+    }
+    TokenizerRules withoutStopwords = rules;
+    withoutStopwords.stopwords.clear();
+    withoutStopwords.minLength = 0;
+    withoutStopwords.maxLength = 0;
+    Tokenizer stopwordTokenizer;
+    stopwordTokenizer.configure(withoutStopwords);
+
+    std::string word;
+    while (file >> word) {
+        std::string normalized = stopwordTokenizer.normalize(word);
+        if (!normalized.empty()) {
+            rules.stopwords.insert(normalized);
+        }
+    }
+    return true;
+}
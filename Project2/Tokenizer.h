@@ -0,0 +1,69 @@
+#ifndef PARALLELPROCESSING_TOKENIZER_H
+#define PARALLELPROCESSING_TOKENIZER_H
+
+#include <string>
+#include <cstdint>
+#include <unordered_set>
+
+// Per-job word rules. The defaults reproduce the original behavior: letters and '-'
+// kept, everything else dropped, no length limits, no stopwords.
+struct TokenizerRules {
+    bool keepApostrophes = false;   // keep ' (and U+2019) between two kept characters: "don't"
+    bool keepDigits = false;        // keep ASCII 0-9
+    unsigned long minLength = 0;    // in code points, after normalizing
+    unsigned long maxLength = 0;    // 0 = no limit
+    std::unordered_set<std::string> stopwords; // compared after normalizing
+
+    bool isDefault() const;
+};
+
+// Byte classes for the normalizing DFA
+enum ByteClass : uint8_t {
+    BYTE_DROP,        // removed; does not break an apostrophe run
+    BYTE_KEEP,        // kept, folded through the fold table
+    BYTE_APOSTROPHE,  // kept only between kept characters
+    BYTE_MULTIBYTE,   // lead of a UTF-8 sequence; decoded and reclassified as KEEP, APOSTROPHE or DROP
+    BYTE_CLASSES
+};
+
+// DFA states
+enum TokenState : uint8_t {
+    TOKEN_START,      // nothing kept yet
+    TOKEN_WORD,       // last kept character was a word character
+    TOKEN_APOSTROPHE, // apostrophe seen after a word character, not yet written
+    TOKEN_STATES
+};
+
+// Rules compiled to a 256-entry byte class table, a byte fold table and a
+// 3-state transition table. normalize() picks the fixed default path at compile
+// time when the rules are the defaults.
+class Tokenizer {
+public:
+    Tokenizer();
+    void configure(const TokenizerRules& newRules);
+    const TokenizerRules& getRules() const;
+    std::string normalize(const std::string& word) const;
+
+    template <bool CustomRules>
+    std::string normalizeWith(const std::string& word) const;
+
+private:
+    TokenizerRules rules;
+    bool custom;
+    uint8_t byteClass[256];
+    char fold[256];
+    uint8_t nextState[TOKEN_STATES][BYTE_CLASSES];
+
+    bool accept(const std::string& normalized) const;
+};
+
+template <>
+std::string Tokenizer::normalizeWith<false>(const std::string& word) const;
+template <>
+std::string Tokenizer::normalizeWith<true>(const std::string& word) const;
+
+bool loadStopwords(const std::string& fileName, TokenizerRules& rules);
+
+extern Tokenizer activeTokenizer; // set up once in main before any counting starts
+
+#endif //PARALLELPROCESSING_TOKENIZER_H
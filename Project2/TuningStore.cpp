@@ -0,0 +1,114 @@
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <unordered_set>
+#include <algorithm>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include "WordCount.h"
+#include "TuningStore.h"
+
+using namespace std;
+
+//hostname and hardware thread count; a tuned setting only applies on the machine it was measured on
+string hostKey() {
+    char name[256] = "unknown";
+    gethostname(name, sizeof(name) - 1);
+    return string(name) + "-" + to_string(thread::hardware_concurrency());
+}
+
+/**
+ * Size class and how repetitive the text is, e.g. "medium-natural".
+ * Sizes: small under 16 MB, medium under 1 GB, large above. The share of distinct
+ * words in the first megabyte separates repetitive logs (under 10%) from natural
+ * text (under 30%) and diverse text such as word lists or identifiers.
+ */
+string classifyCorpus(unsigned long length, unsigned long words, unsigned long distinctWords) {
+    string size = length < 16UL * 1024 * 1024 ? "small" : length < 1024UL * 1024 * 1024 ? "medium" : "large";
+    double share = words == 0 ? 0 : (double)distinctWords / words;
+    string vocabulary = share < 0.1 ? "repetitive" : share < 0.3 ? "natural" : "diverse";
+    return size + "-" + vocabulary;
+}
+
+//class of a file, from its length and its first CLASS_SAMPLE_BYTES normalized as when counting;
+//Project1 and Project2 both call this, so a file gets the same class in either
+string corpusClass(const string& fileName) {
+    ifstream file(fileName);
+    file.seekg(0, ios::end);
+    long length = file ? (long)file.tellg() : 0;
+    file.seekg(0);
+    unordered_set<string> distinct;
+    unsigned long words = 0;
+    string word;
+    while (file >> ws && file.tellg() < (long)CLASS_SAMPLE_BYTES && file >> word) {
+        string normalized = normalizeWord(word);
+        if (normalized.empty()) continue;
+        distinct.insert(normalized);
+        words++;
+    }
+    return classifyCorpus(max(0L, length), words, distinct.size());
+}
+
+//$HOME/.wordcount_tuning, or the working directory without a home
+string defaultTuningPath() {
+    const char* home = getenv("HOME");
+    return home != nullptr ? string(home) + "/.wordcount_tuning" : ".wordcount_tuning";
+}
+
+// One setting per line: host corpusClass threads chunkBytes tableScale throughput
+bool loadTuning(const string& path, const string& host, const string& corpus, TuningConfig& config) {
+    ifstream file(path);
+    string line;
+    while (getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        istringstream fields(line);
+        string lineHost;
+        string lineCorpus;
+        TuningConfig entry;
+        if (fields >> lineHost >> lineCorpus >> entry.threads >> entry.chunkBytes >> entry.tableScale >> entry.throughput &&
+            lineHost == host && lineCorpus == corpus && entry.threads > 0 && entry.tableScale > 0) {
+            config = entry;
+            return true;
+        }
+    }
+    return false;
+}
+
+//replaces the line for this host and corpus class, keeping the others; written beside `path` and renamed over it
+bool saveTuning(const string& path, const string& host, const string& corpus, const TuningConfig& config) {
+    vector<string> lines;
+    {
+        ifstream file(path);
+        string line;
+        while (getline(file, line)) {
+            istringstream fields(line);
+            string lineHost;
+            string lineCorpus;
+            fields >> lineHost >> lineCorpus;
+            if (lineHost != host || lineCorpus != corpus) {
+                lines.push_back(line);
+            }
+        }
+    }
+    if (lines.empty()) {
+        lines.push_back("# host corpusClass threads chunkBytes tableScale throughputMBps");
+    }
+    ostringstream entry;
+    entry << host << " " << corpus << " " << config.threads << " " << config.chunkBytes << " "
+          << config.tableScale << " " << (unsigned long)config.throughput;
+    lines.push_back(entry.str());
+
+    string temporary = path + ".tmp";
+    {
+        ofstream out(temporary);
+        for (const string& line : lines) {
+            out << line << "\n";
+        }
+        if (!out) {
+            return false;
+        }
+    }
+    return rename(temporary.c_str(), path.c_str()) == 0;
+}
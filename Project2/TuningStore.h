@@ -0,0 +1,25 @@
+#ifndef PARALLELPROCESSING_TUNINGSTORE_H
+#define PARALLELPROCESSING_TUNINGSTORE_H
+
+#include <string>
+
+const unsigned long CLASS_SAMPLE_BYTES = 1024 * 1024; // read to tell how repetitive a corpus is
+
+// Counting settings that depend on the machine and the corpus
+struct TuningConfig {
+    int threads = 24;
+    unsigned long chunkBytes = 0;  // file chunks threads take in turn; 0 = one chunk per thread
+    double tableScale = 1.0;       // multiplies the estimated table sizes
+    double throughput = 0;         // MB/s on the calibration sample
+};
+
+// The tuning file on its own, without the counting code, so Project1 can read what
+// Project2's --autotune saved
+std::string hostKey();
+std::string classifyCorpus(unsigned long length, unsigned long words, unsigned long distinctWords);
+std::string corpusClass(const std::string& fileName);
+std::string defaultTuningPath();
+bool loadTuning(const std::string& path, const std::string& host, const std::string& corpus, TuningConfig& config);
+bool saveTuning(const std::string& path, const std::string& host, const std::string& corpus, const TuningConfig& config);
+
+#endif //PARALLELPROCESSING_TUNINGSTORE_H
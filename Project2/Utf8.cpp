@@ -0,0 +1,185 @@
+#include <cstring>
+#include <array>
+#include "Utf8Tables.h"
+#include "Utf8.h"
+
+const uint64_t HIGH_BITS = 0x8080808080808080ULL;
+
+//byte -> lowercase letter or '-' to keep, 0 to drop (same rule as the old isalpha/tolower check)
+static std::array<char, 256> buildAsciiFold() {
+    std::array<char, 256> table{};
+    for (int c = 'a'; c <= 'z'; c++) {
+        table[c] = (char)c;
+        table[c - 'a' + 'A'] = (char)c;
+    }
+    table['-'] = '-';
+    return table;
+}
+static const std::array<char, 256> ASCII_FOLD = buildAsciiFold();
+
+//true if no byte has its high bit set; looks at 16 bytes per step
+bool isAsciiText(const char* text, unsigned long length) {
+    unsigned long i = 0;
+    for (; i + 16 <= length; i += 16) {
+        uint64_t first;
+        uint64_t second;
+        memcpy(&first, text + i, 8);
+        memcpy(&second, text + i + 8, 8);
+        if ((first | second) & HIGH_BITS) {
+            return false;
+        }
+    }
+    if (i + 8 <= length) {
+        uint64_t block;
+        memcpy(&block, text + i, 8);
+        if (block & HIGH_BITS) {
+            return false;
+        }
+        i += 8;
+    }
+    for (; i < length; i++) {
+        if ((unsigned char)text[i] & 0x80) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//decodes one code point; returns the bytes used, or 0 if the sequence at `bytes` is malformed
+unsigned long decodeUtf8(const unsigned char* bytes, unsigned long length, uint32_t& codePoint) {
+    unsigned char lead = bytes[0];
+    unsigned long size;
+    uint32_t minimum;
+    if (lead < 0x80) {
+        codePoint = lead;
+        return 1;
+    } else if ((lead & 0xE0) == 0xC0) {
+        size = 2;
+        minimum = 0x80;
+        codePoint = lead & 0x1F;
+    } else if ((lead & 0xF0) == 0xE0) {
+        size = 3;
+        minimum = 0x800;
+        codePoint = lead & 0x0F;
+    } else if ((lead & 0xF8) == 0xF0) {
+        size = 4;
+        minimum = 0x10000;
+        codePoint = lead & 0x07;
+    } else {
+        return 0; // continuation byte or 0xF8..0xFF
+    }
+    if (size > length) {
+        return 0;
+    }
+    for (unsigned long i = 1; i < size; i++) {
+        if ((bytes[i] & 0xC0) != 0x80) {
+            return 0;
+        }
+        codePoint = (codePoint << 6) | (bytes[i] & 0x3F);
+    }
+    if (codePoint < minimum || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF)) {
+        return 0;
+    }
+    return size;
+}
+
+void appendUtf8(std::string& out, uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        out += (char)codePoint;
+    } else if (codePoint < 0x800) {
+        out += (char)(0xC0 | (codePoint >> 6));
+        out += (char)(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        out += (char)(0xE0 | (codePoint >> 12));
+        out += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+        out += (char)(0x80 | (codePoint & 0x3F));
+    } else {
+        out += (char)(0xF0 | (codePoint >> 18));
+        out += (char)(0x80 | ((codePoint >> 12) & 0x3F));
+        out += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+        out += (char)(0x80 | (codePoint & 0x3F));
+    }
+}
+
+//index of the last range starting at or before codePoint, or -1
+template <typename Range, unsigned long N>
+static long findRange(const Range (&ranges)[N], uint32_t codePoint) {
+    unsigned long low = 0;
+    unsigned long high = N;
+    while (low < high) {
+        unsigned long mid = (low + high) / 2;
+        if (ranges[mid].first <= codePoint) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return (long)low - 1;
+}
+
+bool isWordCodePoint(uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        return ASCII_FOLD[codePoint] != 0;
+    }
+    long i = findRange(WORD_RANGES, codePoint);
+    return i >= 0 && codePoint <= WORD_RANGES[i].last;
+}
+
+uint32_t foldCodePoint(uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        return ASCII_FOLD[codePoint] != 0 ? (uint32_t)ASCII_FOLD[codePoint] : codePoint;
+    }
+    long i = findRange(FOLD_RANGES, codePoint);
+    if (i < 0 || codePoint > FOLD_RANGES[i].last || (codePoint - FOLD_RANGES[i].first) % FOLD_RANGES[i].stride != 0) {
+        return codePoint;
+    }
+    return codePoint + FOLD_RANGES[i].delta;
+}
+
+/**
+ * Normalizes one word.
+ * Pure ASCII words (checked 16 bytes at a time) only go through the byte table.
+ * Otherwise ASCII bytes still use the table, and each multibyte sequence is
+ * decoded, classified and folded.
+ */
+std::string normalizeUtf8Word(const std::string& word) {
+    std::string normalized;
+    const unsigned char* bytes = (const unsigned char*)word.data();
+    unsigned long length = word.size();
+
+    if (isAsciiText(word.data(), length)) {
+        normalized.resize(length);
+        unsigned long used = 0;
+        for (unsigned long i = 0; i < length; i++) {
+            char folded = ASCII_FOLD[bytes[i]];
+            normalized[used] = folded;
+            used += folded != 0;
+        }
+        normalized.resize(used);
+        return normalized;
+    }
+
+    normalized.reserve(length);
+    unsigned long i = 0;
+    while (i < length) {
+        if (bytes[i] < 0x80) {
+            char folded = ASCII_FOLD[bytes[i]];
+            if (folded != 0) {
+                normalized += folded;
+            }
+            i++;
+            continue;
+        }
+        uint32_t codePoint;
+        unsigned long size = decodeUtf8(bytes + i, length - i, codePoint);
+        if (size == 0) {
+            i++; // skip one bad byte and resynchronize
+            continue;
+        }
+        if (isWordCodePoint(codePoint)) {
+            appendUtf8(normalized, foldCodePoint(codePoint));
+        }
+        i += size;
+    }
+    return normalized;
+}
@@ -0,0 +1,17 @@
+#ifndef PARALLELPROCESSING_UTF8_H
+#define PARALLELPROCESSING_UTF8_H
+
+#include <string>
+#include <cstdint>
+
+// UTF-8 word normalization: keep letters, combining marks and '-', fold case, drop the rest.
+// Malformed bytes (bad lead or continuation bytes, overlong forms, surrogates, values
+// past U+10FFFF) are dropped one byte at a time.
+bool isAsciiText(const char* text, unsigned long length);
+unsigned long decodeUtf8(const unsigned char* bytes, unsigned long length, uint32_t& codePoint);
+void appendUtf8(std::string& out, uint32_t codePoint);
+bool isWordCodePoint(uint32_t codePoint);
+uint32_t foldCodePoint(uint32_t codePoint);
+std::string normalizeUtf8Word(const std::string& word);
+
+#endif //PARALLELPROCESSING_UTF8_H
@@ -1,24 +1,28 @@
 #include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <omp.h>
+#include <unordered_set>
+#include <unordered_map>
+#include "CountMinSketch.h"
+#include "SpaceSaving.h"
+#include "HyperLogLog.h"
+#include "WordDictionary.h"
+#include "NGramTable.h"
+#include "CountIndex.h"
+#include "Tokenizer.h"
+#include "Affinity.h"
+#include "Autotune.h"
 #include "HashNode.h"
 #include "HashMap.h"
 #include "WordCount.h"
+#include "Utils.h"
 
 using namespace std;
 
-string normalizeWord(const string& word) {
-    string normalized;
-    for (char ch : word) {
-        if(ch >= 0)
-            if (isalpha(ch) || ch == '-') {
-                normalized += tolower(ch);
-            }
-    }
-    return normalized;
-}
-
 //returns total count of words within a table
 int countWords(HashNode** table, int tableSize) {
     int count = 0;
@@ -30,52 +34,6 @@ int countWords(HashNode** table, int tableSize) {
     return count;
 }
 
-//helper function for merge sort
-void merge(WordCount** arr, int low, int mid, int high) {
-    int n1 = mid - low + 1;
-    int n2 = high - mid;
-
-    WordCount** L = new WordCount * [n1];
-    WordCount** R = new WordCount * [n2];
-
-    for (int i = 0; i < n1; ++i) {
-        L[i] = arr[low + i];
-    }
-    for (int j = 0; j < n2; ++j) {
-        R[j] = arr[mid + 1 + j];
-    }
-
-    int i = 0, j = 0, k = low;
-    while (i < n1 && j < n2) {
-        if (L[i]->count >= R[j]->count) {
-            arr[k++] = L[i++];
-        }
-        else {
-            arr[k++] = R[j++];
-        }
-    }
-
-    while (i < n1) {
-        arr[k++] = L[i++];
-    }
-    while (j < n2) {
-        arr[k++] = R[j++];
-    }
-
-    delete[] L;
-    delete[] R;
-}
-
-//sorting algo
-void mergeSort(WordCount** arr, int low, int high) {
-    if (low < high) {
-        int mid = low + (high - low) / 2;
-        mergeSort(arr, low, mid);
-        mergeSort(arr, mid + 1, high);
-        merge(arr, low, mid, high);
-    }
-}
-
 //outputs final results to output file
 void outputHashMap(HashMap& hashMap, const string& filename) {
     unsigned long totalWords = countWords(hashMap.table, hashMap.tableSize);
@@ -133,32 +91,9 @@ unsigned long estimateHashMapSize(ifstream& file) {
     return hashMapSize > 100 ? hashMapSize : 100; // Ensure a minimum size for the HashMap
 }
 
+//folds a thread's table into the shared main table; see BasicHashMap::mergeFrom
 void mergeResults(HashMap& mainTable, HashMap* threadTable) {
-    for (int i = 0; i < threadTable->tableSize; ++i) {
-        HashNode* threadNode = threadTable->table[i];
-        while (threadNode != nullptr) {
-            // Lock the bucket for thread safety
-
-            // Insert or update the node in the main table
-            HashNode** mainNodePtr = &mainTable.table[mainTable.hashFunction(threadNode->key)];
-            while (*mainNodePtr != nullptr && (*mainNodePtr)->key != threadNode->key) {
-                mainNodePtr = &((*mainNodePtr)->next);
-            }
-
-            if (*mainNodePtr == nullptr) {
-                // Key not found in the main table, insert a new node
-                *mainNodePtr = new HashNode(threadNode->key, threadNode->value);
-            }
-            else {
-                // Key found, update the value
-#pragma omp atomic
-                (*mainNodePtr)->value += threadNode->value;
-            }
-
-            // Move to the next node in the thread-specific table
-            threadNode = threadNode->next;
-        }
-    }
+    mainTable.mergeFrom(*threadTable);
 }
 
 unsigned long findEnd(int threadNum, unsigned long start, unsigned long chunkSize, int numThreads, unsigned long length,  ifstream &file) {
@@ -178,20 +113,23 @@ unsigned long findEnd(int threadNum, unsigned long start, unsigned long chunkSiz
     }
 }
 
-void dispatchThreads(int numThreads, const string& fileName, HashMap& mainTable) {
-    ifstream file(fileName);
+//reads the next word if it starts before `end`; whitespace is skipped first so a word
+//just past the boundary belongs to the next chunk and is not read twice
+bool readWord(ifstream& file, unsigned long end, string& word) {
+    file >> ws;
+    if (!file || file.tellg() >= (long)end) {
+        return false;
+    }
+    return static_cast<bool>(file >> word);
+}
 
-    //Keep track start and end indices of each thread
+//start and end offset of every thread's chunk, as pairs; chunks end on a space
+unsigned long* splitFile(int numThreads, ifstream& file) {
     unsigned long* threadIndices = new unsigned long[numThreads * 2];
-
     unsigned long length = getFileLength(file);
     unsigned long chunkSize = length / numThreads;
-    unsigned long threadTableSize = estimateHashMapSize(file)/ numThreads;
-
-    //Variables to be copied per individual thread in parallel section
     unsigned long start = 0;
     unsigned long end = 0;
-    HashMap* threadTable; // Array of pointers to HashMaps
 
     //Compute start and end positions
     for(int i = 0; i < numThreads; i++) {
@@ -200,32 +138,600 @@ void dispatchThreads(int numThreads, const string& fileName, HashMap& mainTable)
         threadIndices[i*2 + 1] = end;
         start = end;
     }
+    file.clear(); // findEnd may have hit EOF
+    return threadIndices;
+}
+
+void dispatchThreads(int numThreads, const string& fileName, HashMap& mainTable, unsigned long threadTableSize) {
+    ifstream file(fileName);
+
+    //Keep track start and end indices of each chunk; one per thread unless tuning asks for smaller chunks
+    int chunkCount = numThreads;
+    if (activeTuning.chunkBytes > 0) {
+        chunkCount = max(numThreads, (int)((getFileLength(file) + activeTuning.chunkBytes - 1) / activeTuning.chunkBytes));
+    }
+    unsigned long* threadIndices = splitFile(chunkCount, file);
+
+    //Variables to be copied per individual thread in parallel section
+    unsigned long start = 0;
+    unsigned long end = 0;
+    HashMap* threadTable; // Array of pointers to HashMaps
+
+    // Phase report, only when threads are pinned
+    bool reporting = affinityEnabled();
+    double phaseStart = omp_get_wtime();
+    double countEnd = 0;
+    unsigned long mergedNodes = 0;
+    NumaCounters beforeCount = reporting ? readNumaCounters() : NumaCounters();
+    NumaCounters afterCount;
 
 #pragma omp parallel num_threads(numThreads) firstprivate(threadTable, start, end)
     {
         int i = omp_get_thread_num(); // Get the thread index
+        pinWorker(i, numThreads); // before the table is allocated, so it lands on this thread's node
         threadTable = new HashMap(threadTableSize); //independent thread table
 
-        //obtain thread indices
-        start = threadIndices[i * 2];
-        end = threadIndices[i * 2 + 1];
-
-        // cout << "Thread " << i << ": Start: " << start << " End: " << end << endl;
-
         ifstream threadFile(fileName);
-        threadFile.seekg(start);
-        string segment;
+        string batch[INSERT_BATCH];
+        unsigned long batched = 0;
         string word;
 
-        // Read until the designated end position for the thread
-        while (threadFile.tellg() < end && threadFile >> word) {
-            if (!segment.empty()) segment += " ";
-            segment += normalizeWord(word);
+        // Threads take chunks in turn, so one slow chunk doesn't hold the rest back
+#pragma omp for schedule(dynamic)
+        for (int chunk = 0; chunk < chunkCount; chunk++) {
+            //obtain chunk indices
+            start = threadIndices[chunk * 2];
+            end = threadIndices[chunk * 2 + 1];
+
+            // cout << "Thread " << i << ": Start: " << start << " End: " << end << endl;
+
+            threadFile.clear();
+            threadFile.seekg(start);
+
+            // Read until the designated end position for the chunk, inserting a batch at a time
+            while (readWord(threadFile, end, word)) {
+                batch[batched] = normalizeWord(word);
+                if (batch[batched].empty()) continue;
+                if (++batched == INSERT_BATCH) {
+                    threadTable->insertBatch(batch, batched);
+                    batched = 0;
+                }
+            }
+        }
+        threadTable->insertBatch(batch, batched);
+        if (reporting) {
+            unsigned long nodes = countWords(threadTable->table, threadTable->tableSize);
+#pragma omp atomic
+            mergedNodes += nodes;
+#pragma omp barrier
+#pragma omp single
+            {
+                countEnd = omp_get_wtime();
+                afterCount = readNumaCounters();
+            }
         }
-        threadTable->insertWords(segment);
         mergeResults(mainTable, threadTable);
 
         delete threadTable;
     }
     delete [] threadIndices;
-}
\ No newline at end of file
+
+    if (reporting) {
+        NumaCounters afterMerge = readNumaCounters();
+        reportPhase("count", countEnd - phaseStart, getFileLength(file), beforeCount, afterCount);
+        reportPhase("merge", omp_get_wtime() - countEnd, mergedNodes * sizeof(HashNode), afterCount, afterMerge);
+    }
+}
+
+/**
+ * Approximate counting mode with fixed memory.
+ * Each thread feeds its words into its own Count-Min Sketch and Space-Saving
+ * heavy hitter list. The sketches are summed into the first one, with every
+ * thread adding its own slice of the counters. Candidates from all the
+ * heavy hitter lists are then re-estimated from the merged sketch, and the top
+ * `heavyHitters` are written to the output file.
+ *
+ * @param memoryBytes total budget for all thread sketches
+ */
+void dispatchThreadsApproximate(int numThreads, const string& fileName, unsigned long memoryBytes,
+                                unsigned long heavyHitters, const string& outputName) {
+    ifstream file(fileName);
+    unsigned long* threadIndices = splitFile(numThreads, file);
+
+    unsigned long width = CountMinSketch::widthForBytes(memoryBytes / numThreads, SKETCH_DEPTH);
+    auto** sketches = new CountMinSketch*[numThreads];
+    auto** hitters = new SpaceSaving*[numThreads];
+
+#pragma omp parallel num_threads(numThreads)
+    {
+        int i = omp_get_thread_num();
+        pinWorker(i, numThreads);
+        sketches[i] = new CountMinSketch(width, SKETCH_DEPTH);
+        hitters[i] = new SpaceSaving(heavyHitters);
+
+        unsigned long start = threadIndices[i * 2];
+        unsigned long end = threadIndices[i * 2 + 1];
+        ifstream threadFile(fileName);
+        threadFile.seekg(start);
+        string word;
+        while (readWord(threadFile, end, word)) {
+            string normalized = normalizeWord(word);
+            if (normalized.empty()) continue;
+            sketches[i]->add(normalized);
+            hitters[i]->insert(normalized);
+        }
+
+#pragma omp barrier
+        // Every thread sums its own slice of the counters from all sketches into sketch 0
+        unsigned long cells = width * SKETCH_DEPTH;
+        unsigned long begin = cells * i / numThreads;
+        unsigned long finish = cells * (i + 1) / numThreads;
+        for (int t = 1; t < numThreads; t++) {
+            sketches[0]->mergeRange(*sketches[t], begin, finish);
+        }
+    }
+
+    CountMinSketch& merged = *sketches[0];
+    for (int t = 1; t < numThreads; t++) {
+        merged.total += sketches[t]->total;
+    }
+
+    // Re-estimate every candidate from the merged sketch
+    vector<WordCount*> candidates;
+    unordered_set<string> seen;
+    for (int t = 0; t < numThreads; t++) {
+        for (const SpaceSaving::Entry& entry : hitters[t]->heap) {
+            if (seen.insert(entry.word).second) {
+                candidates.push_back(new WordCount(entry.word, (long)merged.estimate(entry.word)));
+            }
+        }
+    }
+    if (!candidates.empty()) {
+        mergeSort(candidates.data(), 0, (int)candidates.size() - 1);
+    }
+
+    ofstream outFile(outputName);
+    for (size_t i = 0; i < candidates.size() && i < heavyHitters; ++i) {
+        outFile << candidates[i]->word << ": " << candidates[i]->count << endl;
+    }
+    outFile.close();
+
+    cout << "Approximate mode: " << numThreads << " sketches of " << SKETCH_DEPTH << " x " << width
+         << " counters (" << numThreads * width * SKETCH_DEPTH * sizeof(uint64_t) / 1024 << " KB)" << endl;
+    cout << "Counted " << merged.total << " words; estimates are at most " << (unsigned long)(merged.epsilon() * merged.total)
+         << " too high (epsilon " << merged.epsilon() << ") with probability " << 1 - merged.delta() << endl;
+    cout << "Any word making up more than 1/" << heavyHitters << " of a thread's chunk is in the heavy hitter list" << endl;
+
+    for (WordCount* candidate : candidates) {
+        delete candidate;
+    }
+    for (int t = 0; t < numThreads; t++) {
+        delete sketches[t];
+        delete hitters[t];
+    }
+    delete[] sketches;
+    delete[] hitters;
+    delete[] threadIndices;
+}
+
+//adds the normalized words of bytes [start, end) to the estimator; a word cut at start belongs to the range before
+void addRangeToHyperLogLog(const string& fileName, unsigned long start, unsigned long end, HyperLogLog& estimator) {
+    ifstream rangeFile(fileName);
+    if (start > 0) {
+        rangeFile.seekg(start - 1);
+        char c;
+        rangeFile.get(c);
+        while (!isspace((unsigned char)c) && rangeFile.get(c)) {}
+    }
+    string word;
+    while (readWord(rangeFile, end, word)) {
+        string normalized = normalizeWord(word);
+        if (!normalized.empty()) {
+            estimator.add(normalized);
+        }
+    }
+}
+
+/**
+ * Sizes the main and per-thread tables from a HyperLogLog pre-pass.
+ * Small files are estimated exactly: every thread runs over its own chunk,
+ * which gives the thread table sizes directly, and the merge gives the total.
+ * Larger files are sampled with evenly spaced ranges. Vocabulary grows
+ * sub-linearly with text length (Heaps' law, V = K * n^beta), so beta is
+ * measured by comparing the distinct count of half the sample with the whole
+ * sample, and both table sizes are extrapolated along that curve.
+ * Both sizes are then scaled by the tuned table scale (see autotune).
+ */
+void estimateTableSizes(const string& fileName, int numThreads, unsigned long& mainTableSize, unsigned long& threadTableSize) {
+    ifstream file(fileName);
+    unsigned long length = getFileLength(file);
+    unsigned long rangeCount = (unsigned long)numThreads * SAMPLE_RANGES_PER_THREAD;
+
+    if (length <= rangeCount * SAMPLE_RANGE_BYTES * 2) {
+        unsigned long* threadIndices = splitFile(numThreads, file);
+        auto** estimators = new HyperLogLog*[numThreads];
+        double largestChunk = 0;
+#pragma omp parallel for num_threads(numThreads) reduction(max:largestChunk)
+        for (int i = 0; i < numThreads; i++) {
+            estimators[i] = new HyperLogLog(HLL_PRECISION);
+            addRangeToHyperLogLog(fileName, threadIndices[i * 2], threadIndices[i * 2 + 1], *estimators[i]);
+            largestChunk = max(largestChunk, estimators[i]->estimate());
+        }
+        for (int i = 1; i < numThreads; i++) {
+            estimators[0]->merge(*estimators[i]);
+        }
+        mainTableSize = max(100UL, (unsigned long)(estimators[0]->estimate() * activeTuning.tableScale));
+        threadTableSize = max(100UL, (unsigned long)(largestChunk * activeTuning.tableScale));
+        for (int i = 0; i < numThreads; i++) {
+            delete estimators[i];
+        }
+        delete[] estimators;
+        delete[] threadIndices;
+        return;
+    }
+
+    // Odd ranges only feed the full-sample estimator, even ranges feed both
+    auto** halfSample = new HyperLogLog*[numThreads];
+    auto** fullSample = new HyperLogLog*[numThreads];
+#pragma omp parallel num_threads(numThreads)
+    {
+        int i = omp_get_thread_num();
+        halfSample[i] = new HyperLogLog(HLL_PRECISION);
+        fullSample[i] = new HyperLogLog(HLL_PRECISION);
+#pragma omp for
+        for (unsigned long range = 0; range < rangeCount; range++) {
+            unsigned long start = length / rangeCount * range;
+            HyperLogLog rangeEstimator(HLL_PRECISION);
+            addRangeToHyperLogLog(fileName, start, start + SAMPLE_RANGE_BYTES, rangeEstimator);
+            fullSample[i]->merge(rangeEstimator);
+            if (range % 2 == 0) {
+                halfSample[i]->merge(rangeEstimator);
+            }
+        }
+    }
+    for (int i = 1; i < numThreads; i++) {
+        halfSample[0]->merge(*halfSample[i]);
+        fullSample[0]->merge(*fullSample[i]);
+    }
+
+    double sampleBytes = (double)rangeCount * SAMPLE_RANGE_BYTES;
+    double sampleDistinct = max(1.0, fullSample[0]->estimate());
+    double halfDistinct = max(1.0, halfSample[0]->estimate());
+    double beta = min(1.0, max(0.3, log2(sampleDistinct / halfDistinct)));
+
+    mainTableSize = max(100UL, (unsigned long)(sampleDistinct * pow(length / sampleBytes, beta) * activeTuning.tableScale));
+    threadTableSize = max(100UL, (unsigned long)(sampleDistinct * pow(length / (double)numThreads / sampleBytes, beta) * activeTuning.tableScale));
+
+    for (int i = 0; i < numThreads; i++) {
+        delete halfSample[i];
+        delete fullSample[i];
+    }
+    delete[] halfSample;
+    delete[] fullSample;
+}
+
+//--distinct mode: HyperLogLog over the whole file, one estimator per thread merged with a max
+void dispatchDistinct(int numThreads, const string& fileName) {
+    ifstream file(fileName);
+    unsigned long* threadIndices = splitFile(numThreads, file);
+    auto** estimators = new HyperLogLog*[numThreads];
+
+#pragma omp parallel for num_threads(numThreads)
+    for (int i = 0; i < numThreads; i++) {
+        estimators[i] = new HyperLogLog(HLL_PRECISION);
+        addRangeToHyperLogLog(fileName, threadIndices[i * 2], threadIndices[i * 2 + 1], *estimators[i]);
+    }
+    for (int i = 1; i < numThreads; i++) {
+        estimators[0]->merge(*estimators[i]);
+    }
+
+    double standardError = 1.04 / sqrt((double)estimators[0]->registerCount);
+    cout << "Distinct words: about " << (unsigned long)estimators[0]->estimate()
+         << " (standard error " << standardError * 100 << "%)" << endl;
+
+    for (int i = 0; i < numThreads; i++) {
+        delete estimators[i];
+    }
+    delete[] estimators;
+    delete[] threadIndices;
+}
+
+//ID of `word`, asking the shared dictionary only the first time this thread sees it
+uint32_t lookupId(const string& word, unordered_map<string, uint32_t>& localIds, WordDictionary& dictionary) {
+    auto found = localIds.find(word);
+    if (found != localIds.end()) {
+        return found->second;
+    }
+    uint32_t id = dictionary.intern(word);
+    localIds.emplace(word, id);
+    return id;
+}
+
+//counts, into `table`, every n-gram of `ids` that starts before `startLimit` and ends inside `ids`
+void countNGrams(const vector<uint32_t>& ids, unsigned long n, unsigned long startLimit, NGramTable& table, unsigned long& distinct) {
+    for (unsigned long start = 0; start < startLimit && start + n <= ids.size(); start++) {
+        NGramKey key;
+        copy(ids.begin() + start, ids.begin() + start + n, key.ids);
+        addNGram(table, distinct, key, 1);
+    }
+}
+
+/**
+ * N-gram counting mode (n from 1 to MAX_NGRAM).
+ * Words are interned to IDs through a per-thread cache in front of the shared
+ * dictionary, and each thread counts the n-grams that lie wholly inside its
+ * chunk. A thread also keeps its first and last n - 1 IDs. After the join the
+ * boundaries are stitched in file order: the trailing IDs carried so far plus
+ * the next chunk's leading IDs hold exactly the n-grams that cross into that
+ * chunk, including ones that pass over chunks shorter than n - 1 words.
+ */
+void dispatchThreadsNGram(int numThreads, const string& fileName, unsigned long n, const string& outputName) {
+    ifstream file(fileName);
+    unsigned long* threadIndices = splitFile(numThreads, file);
+
+    WordDictionary dictionary;
+    auto** threadTables = new NGramTable*[numThreads];
+    vector<unsigned long> distinct(numThreads, 0); // n-grams in each thread table
+    vector<vector<uint32_t>> heads(numThreads);
+    vector<vector<uint32_t>> tails(numThreads);
+
+#pragma omp parallel num_threads(numThreads)
+    {
+        int i = omp_get_thread_num();
+        pinWorker(i, numThreads);
+        threadTables[i] = new NGramTable(1 << 16);
+        unordered_map<string, uint32_t> localIds; // saves taking the dictionary lock for repeat words
+
+        unsigned long start = threadIndices[i * 2];
+        unsigned long end = threadIndices[i * 2 + 1];
+        ifstream threadFile(fileName);
+        threadFile.seekg(start);
+        string word;
+
+        NGramKey window;
+        unsigned long seen = 0;
+        while (readWord(threadFile, end, word)) {
+            string normalized = normalizeWord(word);
+            if (normalized.empty()) continue;
+
+            uint32_t id = lookupId(normalized, localIds, dictionary);
+
+            if (seen < n - 1) {
+                heads[i].push_back(id);
+            }
+            // Slide the window left by one and append
+            if (seen >= n) {
+                memmove(window.ids, window.ids + 1, (n - 1) * sizeof(uint32_t));
+                window.ids[n - 1] = id;
+            } else {
+                window.ids[seen] = id;
+            }
+            seen++;
+            if (seen >= n) {
+                addNGram(*threadTables[i], distinct[i], window, 1);
+            }
+        }
+        unsigned long kept = min(seen, n - 1);
+        tails[i].assign(window.ids + (min(seen, n) - kept), window.ids + min(seen, n));
+    }
+
+    // Stitch the n-grams that cross chunk boundaries
+    NGramTable& mainTable = *threadTables[0];
+    vector<uint32_t> carry = tails[0];
+    for (int i = 1; i < numThreads; i++) {
+        vector<uint32_t> combined = carry;
+        combined.insert(combined.end(), heads[i].begin(), heads[i].end());
+        countNGrams(combined, n, carry.size(), mainTable, distinct[0]);
+
+        // Chunks with fewer than n - 1 words keep earlier words in the carry
+        if (heads[i].size() < n - 1) {
+            carry = combined;
+        } else {
+            carry = tails[i];
+        }
+        if (carry.size() > n - 1) {
+            carry.erase(carry.begin(), carry.end() - (n - 1));
+        }
+    }
+
+    for (int i = 1; i < numThreads; i++) {
+        threadTables[i]->forEach([&](const NGramKey& key, uint64_t count) {
+            addNGram(mainTable, distinct[0], key, count);
+        });
+        delete threadTables[i];
+    }
+
+    // Only now are IDs turned back into text
+    vector<WordCount*> phrases;
+    mainTable.forEach([&](const NGramKey& key, uint64_t count) {
+        string phrase = dictionary.word(key.ids[0]);
+        for (unsigned long k = 1; k < n; k++) {
+            phrase += " " + dictionary.word(key.ids[k]);
+        }
+        phrases.push_back(new WordCount(phrase, (long)count));
+    });
+    if (!phrases.empty()) {
+        mergeSort(phrases.data(), 0, (int)phrases.size() - 1);
+    }
+
+    ofstream outFile(outputName);
+    for (WordCount* phrase : phrases) {
+        outFile << phrase->word << ": " << phrase->count << endl;
+        delete phrase;
+    }
+    outFile.close();
+    cout << "Counted " << distinct[0] << " distinct " << n << "-grams over " << dictionary.size() << " distinct words" << endl;
+
+    delete threadTables[0];
+    delete[] threadTables;
+    delete[] threadIndices;
+}
+
+/**
+ * Exact counting keyed by interned IDs.
+ * Each thread maps its words to IDs (local cache first, shared dictionary on a
+ * miss) and bumps a flat array indexed by ID. After a barrier every array is
+ * padded to the final dictionary size, and the totals are summed with each
+ * thread adding up its own slice of IDs, so merging is plain array addition.
+ * `dictionary` may already hold words from earlier files of a batch; their IDs
+ * are kept and `totals` is resized to cover the whole dictionary.
+ */
+void dispatchThreadsInterned(int numThreads, const string& fileName, WordDictionary& dictionary, vector<uint64_t>& totals) {
+    ifstream file(fileName);
+    unsigned long* threadIndices = splitFile(numThreads, file);
+    vector<vector<uint64_t>> threadCounts(numThreads);
+
+#pragma omp parallel num_threads(numThreads)
+    {
+        int i = omp_get_thread_num();
+        pinWorker(i, numThreads);
+        vector<uint64_t>& counts = threadCounts[i];
+        counts.resize(dictionary.size());
+        unordered_map<string, uint32_t> localIds;
+
+        unsigned long start = threadIndices[i * 2];
+        unsigned long end = threadIndices[i * 2 + 1];
+        ifstream threadFile(fileName);
+        threadFile.seekg(start);
+        string word;
+        while (readWord(threadFile, end, word)) {
+            string normalized = normalizeWord(word);
+            if (normalized.empty()) continue;
+
+            uint32_t id = lookupId(normalized, localIds, dictionary);
+            if (id >= counts.size()) {
+                counts.resize(max((unsigned long)id + 1, 2 * counts.size()));
+            }
+            counts[id]++;
+        }
+
+#pragma omp barrier
+        // Every word is interned now; pad to the final ID range
+        counts.resize(dictionary.size());
+#pragma omp single
+        totals.resize(dictionary.size());
+        // implicit barrier after single
+
+        unsigned long slice = (totals.size() + numThreads - 1) / numThreads;
+        unsigned long sliceStart = min(totals.size(), i * slice);
+        unsigned long sliceEnd = min(totals.size(), sliceStart + slice);
+        for (int t = 0; t < numThreads; t++) {
+            const uint64_t* source = threadCounts[t].data();
+#pragma omp simd
+            for (unsigned long id = sliceStart; id < sliceEnd; id++) {
+                totals[id] += source[id];
+            }
+        }
+    }
+    delete[] threadIndices;
+}
+
+//writes every ID with a nonzero count, most frequent first
+void outputInternedCounts(const WordDictionary& dictionary, const vector<uint64_t>& counts, const string& filename) {
+    vector<WordCount*> wordCounts;
+    for (unsigned long id = 0; id < counts.size(); id++) {
+        if (counts[id] == 0) continue;
+        wordCounts.push_back(new WordCount(dictionary.word(id), (long)counts[id]));
+    }
+    if (!wordCounts.empty()) {
+        mergeSort(wordCounts.data(), 0, (int)wordCounts.size() - 1);
+    }
+
+    ofstream outFile(filename);
+    for (WordCount* wordCount : wordCounts) {
+        outFile << wordCount->word << ": " << wordCount->count << endl;
+        delete wordCount;
+    }
+    outFile.close();
+}
+
+//exact counts of every word in `fileNames` together, sorted by word
+void collectSortedCounts(int numThreads, const vector<string>& fileNames, vector<pair<string, uint64_t>>& entries) {
+    WordDictionary dictionary;
+    vector<uint64_t> totals;
+    for (const string& fileName : fileNames) {
+        dispatchThreadsInterned(numThreads, fileName, dictionary, totals);
+    }
+    entries.clear();
+    for (unsigned long id = 0; id < totals.size(); id++) {
+        if (totals[id] > 0) {
+            entries.emplace_back(dictionary.word(id), totals[id]);
+        }
+    }
+    sort(entries.begin(), entries.end());
+}
+
+/**
+ * Incremental update of a persistent count index.
+ * Steps:
+ * 1. Count only the new files, into one set of ID-keyed totals
+ * 2. Sort the new words and merge them with the sorted keys already in the index
+ * 3. Write the merged result as the next generation of the index
+ * 4. Write the full counts, most frequent first, to outputName
+ * The work is proportional to the new files plus the vocabulary, not to everything
+ * counted so far. With no new files the index is checked and exported as is.
+ *
+ * @return false if the existing index is corrupt or the new one could not be written
+ */
+bool updateCountIndex(int numThreads, const string& indexPath, const vector<string>& newFiles, const string& outputName) {
+    CountIndex previous;
+    bool hasPrevious = previous.open(indexPath);
+    if (!hasPrevious && ifstream(indexPath)) {
+        cerr << "Index " << indexPath << " is not a valid count index." << endl;
+        return false;
+    }
+    if (hasPrevious && !previous.verify()) {
+        cerr << "Index " << indexPath << " failed its checksum." << endl;
+        return false;
+    }
+
+    vector<pair<string, uint64_t>> delta;
+    collectSortedCounts(numThreads, newFiles, delta);
+
+    // Merge two sorted runs
+    vector<pair<string, uint64_t>> merged;
+    merged.reserve(previous.size() + delta.size());
+    unsigned long oldIndex = 0;
+    unsigned long newIndex = 0;
+    while (oldIndex < previous.size() || newIndex < delta.size()) {
+        if (newIndex == delta.size() || (oldIndex < previous.size() && previous.key(oldIndex) < delta[newIndex].first)) {
+            merged.emplace_back(string(previous.key(oldIndex)), previous.count(oldIndex));
+            oldIndex++;
+        } else if (oldIndex == previous.size() || delta[newIndex].first < previous.key(oldIndex)) {
+            merged.push_back(delta[newIndex]);
+            newIndex++;
+        } else {
+            merged.emplace_back(delta[newIndex].first, previous.count(oldIndex) + delta[newIndex].second);
+            oldIndex++;
+            newIndex++;
+        }
+    }
+
+    uint32_t generation = hasPrevious ? previous.generation() : 0;
+    if (!newFiles.empty()) {
+        generation++;
+        previous.close();
+        if (!CountIndex::write(indexPath, merged, generation)) {
+            cerr << "Could not write index " << indexPath << "." << endl;
+            return false;
+        }
+    }
+    cout << "Index " << indexPath << ": generation " << generation << ", " << merged.size()
+         << " words (" << delta.size() << " seen in " << newFiles.size() << " new files)" << endl;
+
+    vector<WordCount*> wordCounts;
+    wordCounts.reserve(merged.size());
+    for (const auto& entry : merged) {
+        wordCounts.push_back(new WordCount(entry.first, (long)entry.second));
+    }
+    if (!wordCounts.empty()) {
+        mergeSort(wordCounts.data(), 0, (int)wordCounts.size() - 1);
+    }
+    ofstream outFile(outputName);
+    for (WordCount* wordCount : wordCounts) {
+        outFile << wordCount->word << ": " << wordCount->count << endl;
+        delete wordCount;
+    }
+    outFile.close();
+    return true;
+}
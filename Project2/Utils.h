@@ -1,25 +1,40 @@
 #include <chrono>
 #include <iostream>
 #include <fstream>
+#include <vector>
 #include "HashNode.h"
 #include "WordCount.h"
 #include "HashMap.h"
+#include "WordDictionary.h"
 
 using namespace std;
 
 #ifndef PARALLELPROCESSING_UTILS_H
 #define PARALLELPROCESSING_UTILS_H
 
-string normalizeWord(const string& word);
+const unsigned long SKETCH_DEPTH = 4; // Count-Min rows; failure probability e^-4 (about 1.8%)
+const unsigned long HLL_PRECISION = 14; // 16K registers, about 0.8% standard error
+const unsigned long SAMPLE_RANGES_PER_THREAD = 4; // byte ranges each thread samples in the pre-pass
+const unsigned long SAMPLE_RANGE_BYTES = 64 * 1024;
+
 int countWords(HashNode** table, int tableSize);
-void merge(WordCount** arr, int low, int mid, int high);
-void mergeSort(WordCount** arr, int low, int high);
 void outputHashMap(HashMap& hashMap, const string& filename);
 long getFileLength(ifstream& file);
 unsigned long estimateHashMapSize(ifstream& file);
 void mergeResults(HashMap& mainTable, HashMap* threadTable);
 unsigned long findEnd(int threadNum, unsigned long start, unsigned long chunkSize, int numThreads, unsigned long length,  ifstream &file);
-void dispatchThreads(int numThreads, const string& fileName, HashMap& mainTable);
+bool readWord(ifstream& file, unsigned long end, string& word);
+unsigned long* splitFile(int numThreads, ifstream& file);
+void dispatchThreads(int numThreads, const string& fileName, HashMap& mainTable, unsigned long threadTableSize);
+void dispatchThreadsApproximate(int numThreads, const string& fileName, unsigned long memoryBytes,
+                                unsigned long heavyHitters, const string& outputName);
+void estimateTableSizes(const string& fileName, int numThreads, unsigned long& mainTableSize, unsigned long& threadTableSize);
+void dispatchDistinct(int numThreads, const string& fileName);
+void dispatchThreadsNGram(int numThreads, const string& fileName, unsigned long n, const string& outputName);
+void dispatchThreadsInterned(int numThreads, const string& fileName, WordDictionary& dictionary, vector<uint64_t>& totals);
+void outputInternedCounts(const WordDictionary& dictionary, const vector<uint64_t>& counts, const string& filename);
+void collectSortedCounts(int numThreads, const vector<string>& fileNames, vector<pair<string, uint64_t>>& entries);
+bool updateCountIndex(int numThreads, const string& indexPath, const vector<string>& newFiles, const string& outputName);
 
 
 #endif //PARALLELPROCESSING_UTILS_H
@@ -0,0 +1,64 @@
+#include "Tokenizer.h"
+#include "WordCount.h"
+
+using namespace std;
+
+//letters (any script), combining marks and '-', case folded, plus whatever the job's
+//tokenizer rules add or filter; empty when the word should not be counted
+string normalizeWord(const string& word) {
+    return activeTokenizer.normalize(word);
+}
+
+//output order: higher count first, ties broken alphabetically so the order is the same on every run
+bool wordCountBefore(const WordCount* a, const WordCount* b) {
+    if (a->count != b->count) {
+        return a->count > b->count;
+    }
+    return a->word < b->word;
+}
+
+//helper function for merge sort
+void merge(WordCount** arr, int low, int mid, int high) {
+    int n1 = mid - low + 1;
+    int n2 = high - mid;
+
+    WordCount** L = new WordCount * [n1];
+    WordCount** R = new WordCount * [n2];
+
+    for (int i = 0; i < n1; ++i) {
+        L[i] = arr[low + i];
+    }
+    for (int j = 0; j < n2; ++j) {
+        R[j] = arr[mid + 1 + j];
+    }
+
+    int i = 0, j = 0, k = low;
+    while (i < n1 && j < n2) {
+        if (!wordCountBefore(R[j], L[i])) {
+            arr[k++] = L[i++];
+        }
+        else {
+            arr[k++] = R[j++];
+        }
+    }
+
+    while (i < n1) {
+        arr[k++] = L[i++];
+    }
+    while (j < n2) {
+        arr[k++] = R[j++];
+    }
+
+    delete[] L;
+    delete[] R;
+}
+
+//sorting algo
+void mergeSort(WordCount** arr, int low, int high) {
+    if (low < high) {
+        int mid = low + (high - low) / 2;
+        mergeSort(arr, low, mid);
+        mergeSort(arr, mid + 1, high);
+        merge(arr, low, mid, high);
+    }
+}
@@ -2,6 +2,7 @@
 #define PARALLELPROCESSING_WORDCOUNT_H
 
 #include <iostream>
+#include <string>
 
 using namespace std;
 
@@ -11,7 +12,13 @@ public:
     long count;
 
     WordCount() : word(""), count(0) {}
-    explicit WordCount(std::string  w, int c) : word(std::move(w)), count(c) {}
+    explicit WordCount(std::string  w, long c) : word(std::move(w)), count(c) {}
 };
 
+// Shared by Project1 and Project2, so both count and order words the same way
+string normalizeWord(const string& word);
+bool wordCountBefore(const WordCount* a, const WordCount* b);
+void merge(WordCount** arr, int low, int mid, int high);
+void mergeSort(WordCount** arr, int low, int high);
+
 #endif //PARALLELPROCESSING_WORDCOUNT_H
@@ -0,0 +1,51 @@
+#include "WordDictionary.h"
+#include "BasicHashMap.h"
+
+//Constructor
+WordDictionary::WordDictionary() : nextId(0) {
+    blocks = new std::atomic<std::string*>[DICTIONARY_MAX_BLOCKS];
+    for (unsigned long i = 0; i < DICTIONARY_MAX_BLOCKS; i++) {
+        blocks[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+// Destructor
+WordDictionary::~WordDictionary() {
+    for (unsigned long i = 0; i < DICTIONARY_MAX_BLOCKS; i++) {
+        delete[] blocks[i].load(std::memory_order_relaxed);
+    }
+    delete[] blocks;
+}
+
+uint32_t WordDictionary::intern(const std::string& word) {
+    Shard& shard = shards[ownerOf(KeyHash<std::string>()(word), DICTIONARY_SHARDS)];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    auto found = shard.ids.find(word);
+    if (found != shard.ids.end()) {
+        return found->second;
+    }
+
+    uint32_t id = nextId.fetch_add(1, std::memory_order_relaxed);
+    unsigned long blockIndex = id >> DICTIONARY_BLOCK_BITS;
+    std::string* block = blocks[blockIndex].load(std::memory_order_acquire);
+    if (block == nullptr) {
+        std::lock_guard<std::mutex> blockGuard(blockLock);
+        block = blocks[blockIndex].load(std::memory_order_relaxed);
+        if (block == nullptr) {
+            block = new std::string[1UL << DICTIONARY_BLOCK_BITS];
+            blocks[blockIndex].store(block, std::memory_order_release);
+        }
+    }
+    block[id & ((1UL << DICTIONARY_BLOCK_BITS) - 1)] = word;
+    shard.ids.emplace(word, id);
+    return id;
+}
+
+// Safe for any ID this thread got from intern, or for any ID once interning has finished
+const std::string& WordDictionary::word(uint32_t id) const {
+    return blocks[id >> DICTIONARY_BLOCK_BITS].load(std::memory_order_acquire)[id & ((1UL << DICTIONARY_BLOCK_BITS) - 1)];
+}
+
+unsigned long WordDictionary::size() const {
+    return nextId.load(std::memory_order_acquire);
+}
@@ -0,0 +1,37 @@
+#ifndef PARALLELPROCESSING_WORDDICTIONARY_H
+#define PARALLELPROCESSING_WORDDICTIONARY_H
+
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <unordered_map>
+
+const unsigned long DICTIONARY_SHARDS = 64;        // independent locks; a word's hash picks its shard
+const unsigned long DICTIONARY_BLOCK_BITS = 16;    // ID -> word storage grows 64K words at a time
+const unsigned long DICTIONARY_MAX_BLOCKS = 1UL << (32 - DICTIONARY_BLOCK_BITS);
+
+// Concurrent word <-> dense 32-bit ID mapping. IDs are handed out in order of first sight,
+// so per-thread counts can live in flat arrays indexed by ID. One dictionary can be
+// kept for a whole batch of files so IDs stay the same from file to file.
+class WordDictionary {
+public:
+    WordDictionary();
+    ~WordDictionary();
+    uint32_t intern(const std::string& word);
+    const std::string& word(uint32_t id) const;
+    unsigned long size() const;
+
+private:
+    struct Shard {
+        std::mutex lock;
+        std::unordered_map<std::string, uint32_t> ids;
+    };
+
+    Shard shards[DICTIONARY_SHARDS];
+    std::atomic<uint32_t> nextId;
+    std::atomic<std::string*>* blocks; // blocks[id >> DICTIONARY_BLOCK_BITS][id & mask] is the word
+    std::mutex blockLock;
+};
+
+#endif //PARALLELPROCESSING_WORDDICTIONARY_H
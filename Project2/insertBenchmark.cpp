@@ -0,0 +1,110 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <cstring>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#endif
+#include "HashMap.h"
+#include "HugePages.h"
+
+using namespace std;
+
+//opens a counter of this thread's data TLB load misses; -1 if perf events are unavailable
+int openTlbCounter() {
+#ifdef __linux__
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+/**
+ * Compares HashMap::insert with HashMap::insertBatch, each with 4 KB pages and with
+ * huge pages, on a vocabulary much larger than the last level cache, where every
+ * probe of a plain insert is a cache miss. dTLB load misses are shown when the
+ * kernel allows perf events.
+ * Usage: insertBenchmark [distinct words, default 4M] [tokens, default 20M]
+ * Both runs count the same uniformly random token stream into a table sized to the
+ * vocabulary (load factor 1, as estimateTableSizes would size it).
+ */
+int main(int argc, char* argv[]) {
+    unsigned long vocabularySize = argc > 1 ? stoul(argv[1]) : 4000000;
+    unsigned long tokenCount = argc > 2 ? stoul(argv[2]) : 20000000;
+
+    // Distinct 8 to 12 letter words (short enough for the small string buffer, like most real words)
+    mt19937_64 random(42);
+    vector<string> vocabulary(vocabularySize);
+    for (unsigned long i = 0; i < vocabularySize; i++) {
+        unsigned long value = i;
+        string word(1, 'a' + random() % 26);
+        for (int k = 0; k < 7 || value > 0; k++) {
+            word += (char)('a' + value % 26);
+            value /= 26;
+        }
+        vocabulary[i] = word + string(random() % 5, 'z');
+    }
+    vector<uint32_t> tokens(tokenCount);
+    for (unsigned long i = 0; i < tokenCount; i++) {
+        tokens[i] = random() % vocabularySize;
+    }
+
+    cout << "Vocabulary: " << vocabularySize << " words, tokens: " << tokenCount << endl;
+    string batch[INSERT_BATCH];
+    for (int run = 0; run < 4; run++) {
+        bool batched = run % 2 == 1;
+        configureHugePages(run >= 2);
+        HashMap table(vocabularySize);
+        // Warm the table so every run measures probing, not node allocation
+        for (unsigned long i = 0; i < vocabularySize; i++) {
+            table.insert(vocabulary[i]);
+        }
+
+        int tlbCounter = openTlbCounter();
+#ifdef __linux__
+        if (tlbCounter >= 0) {
+            ioctl(tlbCounter, PERF_EVENT_IOC_RESET, 0);
+            ioctl(tlbCounter, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+        auto begin = chrono::steady_clock::now();
+        unsigned long pending = 0;
+        for (unsigned long i = 0; i < tokenCount; i++) {
+            batch[pending++] = vocabulary[tokens[i]];
+            if (pending == INSERT_BATCH) {
+                if (batched) {
+                    table.insertBatch(batch, pending);
+                } else {
+                    for (unsigned long k = 0; k < pending; k++) {
+                        table.insert(batch[k]);
+                    }
+                }
+                pending = 0;
+            }
+        }
+        auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin);
+
+        cout << (batched ? "insertBatch" : "insert     ") << (run >= 2 ? ", huge pages: " : ", 4 KB pages: ")
+             << (double)elapsed.count() / tokenCount << " ns/token";
+        long long misses = 0;
+        if (tlbCounter >= 0 && read(tlbCounter, &misses, sizeof(misses)) == sizeof(misses)) {
+            cout << ", " << (double)misses / tokenCount << " dTLB load misses/token";
+            close(tlbCounter);
+        }
+        cout << endl;
+    }
+    return 0;
+}
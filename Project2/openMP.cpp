@@ -2,28 +2,254 @@
 #include <fstream>
 #include "HashMap.h"
 #include "Utils.h"
+#include "NGramTable.h"
+#include "QueryServer.h"
+#include "Tokenizer.h"
+#include "Affinity.h"
+#include "HugePages.h"
+#include "ExternalCount.h"
+#include "Pipeline.h"
+#include "CompressedInput.h"
+#include "Autotune.h"
 
 using namespace std;
 
-int main() {
-    cout << "using openMP!" << endl;
+int main(int argc, char* argv[]) {
     int numThreads = 24;
-    string fileName = "combined.txt";
-    ifstream inputFile(fileName);
+    vector<string> fileNames;
 
-    //Make sure file is valid
-    if (!inputFile) {
-        cerr << "Error opening input file." << endl;
+    //Approximate mode: --approx [--sketch-mb N] [--top K]; distinct count only: --distinct
+    //Phrase counts: --ngram N (1 to 5); ID-keyed counts: --interned
+    //Persistent counts: --index PATH [new files...] merges the new files into the index
+    //Query server: --serve [--socket PATH], counts from --index PATH or the input files
+    //Tokenizer: --keep-apostrophes --keep-digits --min-length N --max-length N --stopwords FILE
+    //NUMA: --pin pins threads per node, interleaves the main table and reports each phase
+    //Memory: --huge-pages backs large tables with 2 MB pages
+    //External aggregation: --memory-mb N [--spill-dir DIR] spills thread tables to disk past N MiB
+    //Staged pipeline: --pipeline R,T,A reader, tokenizer and aggregator threads
+    //  [--io-uring [--queue-depth N]] [--direct] reads with one asynchronous reader instead
+    //  gzip or zstd input is detected and always counted this way, with R decoder threads
+    //Tuning: --autotune calibrates threads, chunk size and table size on a sample and saves them per
+    //  host and corpus class in --tuning-file PATH (default ~/.wordcount_tuning); later runs load them
+    //  unless --no-tune. --threads N overrides the thread count
+    //Any other argument is an input file (default combined.txt)
+    bool approximate = false;
+    bool interned = false;
+    string indexPath;
+    bool serve = false;
+    string socketPath;
+    TokenizerRules rules;
+    string stopwordFile;
+    bool pin = false;
+    bool hugePages = false;
+    unsigned long memoryMegabytes = 0;
+    bool tune = false;
+    bool useTuning = true;
+    string tuningPath = defaultTuningPath();
+    int requestedThreads = 0;
+    bool pipelined = false;
+    PipelineConfig pipeline;
+    string spillDir = getenv("TMPDIR") != nullptr ? getenv("TMPDIR") : "/tmp";
+    bool distinctOnly = false;
+    unsigned long ngram = 0;
+    unsigned long sketchMegabytes = 64;
+    unsigned long heavyHitters = 1000;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--approx") {
+            approximate = true;
+        } else if (arg == "--interned") {
+            interned = true;
+        } else if (arg == "--index" && i + 1 < argc) {
+            indexPath = argv[++i];
+        } else if (arg == "--serve") {
+            serve = true;
+        } else if (arg == "--socket" && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if (arg == "--keep-apostrophes") {
+            rules.keepApostrophes = true;
+        } else if (arg == "--keep-digits") {
+            rules.keepDigits = true;
+        } else if (arg == "--min-length" && i + 1 < argc) {
+            rules.minLength = stoul(argv[++i]);
+        } else if (arg == "--max-length" && i + 1 < argc) {
+            rules.maxLength = stoul(argv[++i]);
+        } else if (arg == "--stopwords" && i + 1 < argc) {
+            stopwordFile = argv[++i];
+        } else if (arg == "--pin") {
+            pin = true;
+        } else if (arg == "--huge-pages") {
+            hugePages = true;
+        } else if (arg == "--memory-mb" && i + 1 < argc) {
+            memoryMegabytes = stoul(argv[++i]);
+        } else if (arg == "--spill-dir" && i + 1 < argc) {
+            spillDir = argv[++i];
+        } else if (arg == "--pipeline" && i + 1 < argc) {
+            pipelined = true;
+            if (!parsePipelineConfig(argv[++i], pipeline)) {
+                cerr << "--pipeline takes three positive thread counts, e.g. 2,8,4" << endl;
+                return 1;
+            }
+        } else if (arg == "--io-uring") {
+            pipeline.asyncReads = true;
+        } else if (arg == "--direct") {
+            pipeline.directReads = true;
+        } else if (arg == "--queue-depth" && i + 1 < argc) {
+            pipeline.queueDepth = stoul(argv[++i]);
+        } else if (arg == "--autotune") {
+            tune = true;
+        } else if (arg == "--no-tune") {
+            useTuning = false;
+        } else if (arg == "--tuning-file" && i + 1 < argc) {
+            tuningPath = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            requestedThreads = stoi(argv[++i]);
+        } else if (arg == "--distinct") {
+            distinctOnly = true;
+        } else if (arg == "--sketch-mb" && i + 1 < argc) {
+            sketchMegabytes = stoul(argv[++i]);
+        } else if (arg == "--top" && i + 1 < argc) {
+            heavyHitters = stoul(argv[++i]);
+        } else if (arg == "--ngram" && i + 1 < argc) {
+            ngram = stoul(argv[++i]);
+            if (ngram < 1 || ngram > MAX_NGRAM) {
+                cerr << "--ngram must be between 1 and " << MAX_NGRAM << endl;
+                return 1;
+            }
+        } else {
+            fileNames.push_back(arg);
+        }
+    }
+    if (pipeline.asyncReads || pipeline.directReads) {
+        pipelined = true; // the block reader feeds the pipeline's tokenizers
+    }
+    if (!stopwordFile.empty() && !loadStopwords(stopwordFile, rules)) {
+        cerr << "Error opening stopword file " << stopwordFile << "." << endl;
         return 1;
     }
+    activeTokenizer.configure(rules);
+    configureAffinity(pin);
+    configureHugePages(hugePages);
+    if (serve) {
+        if (indexPath.empty() && fileNames.empty()) {
+            fileNames.push_back("combined.txt");
+        }
+        for (const string& name : fileNames) {
+            if (!ifstream(name)) {
+                cerr << "Error opening input file " << name << "." << endl;
+                return 1;
+            }
+        }
+        return dispatchServer(numThreads, indexPath, fileNames, socketPath) ? 0 : 1;
+    }
+    // After the server branch: there stdout carries the query protocol and nothing else
+    cout << "using openMP!" << endl;
+    if (!indexPath.empty()) {
+        // Only the files named on the command line are counted; no default input here
+        for (const string& name : fileNames) {
+            if (!ifstream(name)) {
+                cerr << "Error opening input file " << name << "." << endl;
+                return 1;
+            }
+        }
+        return updateCountIndex(numThreads, indexPath, fileNames, "output.txt") ? 0 : 1;
+    }
+    if (fileNames.empty()) {
+        fileNames.push_back("combined.txt");
+    }
+    string fileName = fileNames[0];
+
+    //Make sure files are valid
+    for (const string& name : fileNames) {
+        if (!ifstream(name)) {
+            cerr << "Error opening input file " << name << "." << endl;
+            return 1;
+        }
+    }
+    // gzip and zstd input is decompressed in memory by the pipeline's reader stage
+    InputFormat format = detectFormat(fileName);
+    if (format != InputFormat::Plain) {
+        if (interned || distinctOnly || ngram > 0 || approximate || memoryMegabytes > 0) {
+            cerr << formatName(format) << " input is only supported by the default count and --pipeline." << endl;
+            return 1;
+        }
+    }
+    // Settings measured for this machine and this kind of corpus replace the defaults
+    if (format == InputFormat::Plain && (tune || useTuning)) {
+        string host = hostKey();
+        string corpus = corpusClass(fileName);
+        TuningConfig tuned;
+        if (tune) {
+            tuned = autotune(fileName, spillDir, numThreads);
+            if (!saveTuning(tuningPath, host, corpus, tuned)) {
+                cerr << "Could not save tuning to " << tuningPath << "." << endl;
+            }
+            activeTuning = tuned;
+            numThreads = tuned.threads;
+        } else if (loadTuning(tuningPath, host, corpus, tuned)) {
+            cout << "Using tuned settings for " << corpus << " from " << tuningPath << endl;
+            activeTuning = tuned;
+            numThreads = tuned.threads;
+        }
+    }
+    if (requestedThreads > 0) {
+        numThreads = requestedThreads;
+    }
+    activeTuning.threads = numThreads;
+    // Compressed input always goes through the pipeline, sized from the final thread count
+    if (format != InputFormat::Plain && !pipelined) {
+        pipelined = true;
+        pipeline.readers = max(1, numThreads / 4);
+        pipeline.tokenizers = max(1, numThreads / 2);
+        pipeline.aggregators = max(1, numThreads / 4);
+    }
     cout << "File Name: " << fileName << endl;
     cout << "Using " << numThreads << ((numThreads > 1 ) ? " threads" : " thread") << endl;
 
-    unsigned long hashMapSize = estimateHashMapSize(inputFile);
+    if (interned) {
+        // One dictionary for the whole batch, so a word has the same ID in every file
+        WordDictionary dictionary;
+        for (unsigned long k = 0; k < fileNames.size(); k++) {
+            vector<uint64_t> counts;
+            dispatchThreadsInterned(numThreads, fileNames[k], dictionary, counts);
+            string outputName = fileNames.size() == 1 ? "output.txt" : "output_" + to_string(k + 1) + ".txt";
+            outputInternedCounts(dictionary, counts, outputName);
+            cout << fileNames[k] << " -> " << outputName << " (" << dictionary.size() << " words in dictionary)" << endl;
+        }
+        return 0;
+    }
+
+    if (distinctOnly) {
+        dispatchDistinct(numThreads, fileName);
+        return 0;
+    }
+    if (ngram > 0) {
+        dispatchThreadsNGram(numThreads, fileName, ngram, "output.txt");
+        return 0;
+    }
+    if (approximate) {
+        dispatchThreadsApproximate(numThreads, fileName, sketchMegabytes * 1024 * 1024, heavyHitters, "output.txt");
+        return 0;
+    }
+
+    if (pipelined) {
+        return dispatchPipeline(pipeline, fileName, "output.txt") ? 0 : 1;
+    }
+
+    if (memoryMegabytes > 0) {
+        return dispatchThreadsExternal(numThreads, fileName, memoryMegabytes * 1024 * 1024, spillDir, "output.txt") ? 0 : 1;
+    }
+
+    // Size the tables from a HyperLogLog estimate of the vocabulary
+    unsigned long hashMapSize = 0;
+    unsigned long threadTableSize = 0;
+    estimateTableSizes(fileName, numThreads, hashMapSize, threadTableSize);
+    cout << "Estimated distinct words: " << hashMapSize << " (" << threadTableSize << " per thread)" << endl;
 
     HashMap wordCount(hashMapSize); // Start with an initial size
+    interleaveAcrossNodes(wordCount.table, wordCount.tableSize * sizeof(HashNode*)); // shared by every socket
 
-    dispatchThreads(numThreads, fileName, wordCount);
+    dispatchThreads(numThreads, fileName, wordCount, threadTableSize);
     outputHashMap(wordCount, "output.txt");
 
     return 0;
@@ -0,0 +1,35 @@
+#include <iostream>
+#include <fstream>
+#include "DistributedCount.h"
+
+using namespace std;
+
+int main() {
+    string fileName = "combined.txt";
+
+    //init MPI vars
+    MPI_Init(NULL, NULL);
+    int worldSize;
+    int worldRank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &worldRank);
+    MPI_Comm_size(MPI_COMM_WORLD, &worldSize);
+
+    //Make sure file is valid
+    if (!ifstream(fileName)) {
+        if (worldRank == 0) {
+            cerr << "Error opening input file." << endl;
+        }
+        MPI_Finalize();
+        return 1;
+    }
+    if (worldRank == 0) {
+        cout << "using openMPI!" << endl;
+        cout << "File Name: " << fileName << endl;
+        cout << "Using " << worldSize << ((worldSize > 1) ? " processes" : " process") << endl;
+    }
+
+    dispatchMPI(fileName, worldRank, worldSize, "output.txt");
+
+    MPI_Finalize();
+    return 0;
+}
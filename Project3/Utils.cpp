@@ -1,30 +1,34 @@
 #include <chrono>
 #include <iostream>
 #include <fstream>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+#include "Utils.h"
 #include "/usr/local/Cellar/open-mpi/5.0.2/include/mpi.h"
 
 using namespace std;
 
-string masterCoords = "";
-const int MAX_COORD_LENGTH = 1024; // Adjust as necessary
+vector<MatchRecord> masterMatches;
 
-string* obtainLines(int startRow, int endRow, int worldRank, string& fileName,  string* processLines) {
+//reads the rows [rowStart, rowEnd) of the input, keeping only columns [colStart, colEnd)
+vector<string> obtainTile(string& fileName, int rowStart, int rowEnd, int colStart, int colEnd) {
     ifstream file(fileName);
+    vector<string> tileLines;
     // Skip lines until reaching the start row for this process
     string line;
-    for (int i = 0; i < startRow && getline(file, line); ++i) {}
-
-    // Read and process the assigned rows
-    int currentRow = startRow;
-    int index = 0;
-    while (currentRow <= endRow && getline(file, line)) {
-        // Process the line here
-        // cout << "Process " << worldRank << " reading row " << currentRow << endl;
-        processLines[index] = line;
-        index++;
-        currentRow++;
-    }
-    return processLines;
+    for (int i = 0; i < rowStart && getline(file, line); ++i) {}
+
+    for (int currentRow = rowStart; currentRow < rowEnd && getline(file, line); currentRow++) {
+        if (colStart < (int)line.length()) {
+            line = line.substr(colStart, colEnd - colStart);
+        } else {
+            line.clear();
+        }
+        line.resize(colEnd - colStart, '\0'); // pad short lines so the tile stays rectangular
+        tileLines.push_back(line);
+    }
+    return tileLines;
 }
 void getNumColumnRow(string& fileName, unsigned long& numColumns, unsigned long& numRows) {
     ifstream inputFile(fileName);
@@ -46,249 +50,709 @@ void getNumColumnRow(string& fileName, unsigned long& numColumns, unsigned long&
     inputFile.close();
 }
 
-void processPattern(string& patternName, unsigned long& numColumns, unsigned long& numRows, string* patternMatch) {
+void processPattern(string& patternName, unsigned long& numColumns, unsigned long& numRows, vector<string>& patternMatch) {
     ifstream inputFile(patternName);
     if (!inputFile) {
         cerr << "Error opening pattern file." << endl;
     }
     string line;
-    numRows = 0; // Initialize numRows to 0
+    patternMatch.clear();
 
     // Read lines from the file and assign each to an index of patternMatch
     while (getline(inputFile, line)) {
-        if (numRows == 0) {
-            // Determine the number of columns from the first line
-            numColumns = line.length();
+        if (line.empty()) continue; // ignore blank trailing lines
+        if (!patternMatch.empty() && line.length() != patternMatch[0].length()) {
+            cout << "Warning: pattern row " << patternMatch.size() + 1 << " has a different width than the first row." << endl;
+            line.resize(patternMatch[0].length(), '\0');
         }
-        if (numRows < 10) { // Ensure we don't exceed the array bounds
-            patternMatch[numRows] = line;
-        } else {
-            cout << "Warning: Pattern file has more than 10 lines; additional lines will be ignored." << endl;
-            break; // Exit the loop if there are more than 10 lines
+        patternMatch.push_back(line);
+    }
+    numRows = patternMatch.size();
+    numColumns = numRows > 0 ? patternMatch[0].length() : 0;
+}
+
+void addCoords(string& outputCoords) {
+    // Output to file
+    ofstream outFile("/Users/austinfrank/Documents/GitHub/ParallelProcessing/Project3/output.txt");
+    outFile << outputCoords << endl;
+    outFile.close();
+}
+
+//MPI datatype matching the layout of MatchRecord (three packed ints)
+MPI_Datatype createMatchRecordType() {
+    MPI_Datatype recordType;
+    MPI_Type_contiguous(3, MPI_INT, &recordType);
+    MPI_Type_commit(&recordType);
+    return recordType;
+}
+
+bool compareMatches(const MatchRecord& a, const MatchRecord& b) {
+    if (a.row != b.row) return a.row < b.row;
+    if (a.col != b.col) return a.col < b.col;
+    return a.patternId < b.patternId;
+}
+
+/**
+ * Gathers every rank's match records at process 0 without truncation.
+ * Counts are gathered first so process 0 can size the receive buffer and
+ * displacements, then the records themselves are gathered with MPI_Gatherv.
+ * Process 0 sorts by global row and column and writes the output file.
+ */
+void gatherMatches(const vector<MatchRecord>& processMatches, int worldRank, int worldSize) {
+    int localCount = static_cast<int>(processMatches.size());
+    vector<int> counts;
+    vector<int> displacements;
+    if (worldRank == 0) {
+        counts.resize(worldSize);
+        displacements.resize(worldSize);
+    }
+
+    MPI_Gather(&localCount, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    int totalCount = 0;
+    if (worldRank == 0) {
+        for (int i = 0; i < worldSize; ++i) {
+            displacements[i] = totalCount;
+            totalCount += counts[i];
         }
-        numRows++;
     }
+
+    vector<MatchRecord> allMatches(totalCount);
+    MPI_Datatype recordType = createMatchRecordType();
+    MPI_Gatherv(processMatches.data(), localCount, recordType,
+                allMatches.data(), counts.data(), displacements.data(), recordType, 0, MPI_COMM_WORLD);
+    MPI_Type_free(&recordType);
+
+    // Process 0 orders all coords and writes them out
+    if (worldRank == 0) {
+        sort(allMatches.begin(), allMatches.end(), compareMatches);
+
+        string combinedCoords;
+        for (const MatchRecord& match : allMatches) {
+            combinedCoords += to_string(match.row) + "," + to_string(match.col) + "\n";
+        }
+        addCoords(combinedCoords);
+        cout << "Gathered " << totalCount << " matches from " << worldSize << " processes" << endl;
+    }
+}
+//first row (or column) of block `index` when `length` is split into `parts` near-equal blocks
+int blockStart(int index, int parts, int length) {
+    return static_cast<int>(static_cast<long>(index) * length / parts);
 }
 
-void requestAdditionalLines(int neededLines, int worldRank, int worldSize, int numColumns, string* receivedLines) {
+/**
+ * Picks the process grid (rows x columns of tiles) for worldSize processes.
+ * Every factorization is tried and the one with the smallest tile perimeter,
+ * which is what the halo exchange has to ship, wins. A tile must be at least
+ * as large as the halo so that a pattern never spans more than two tiles in
+ * either direction.
+ */
+void chooseProcessGrid(int worldSize, unsigned long fileRows, unsigned long fileColumns,
+                       unsigned long patternRows, unsigned long patternColumns, int* dims) {
+    long bestCost = -1;
+    dims[0] = worldSize;
+    dims[1] = 1;
+
+    for (int gridRows = 1; gridRows <= worldSize; gridRows++) {
+        if (worldSize % gridRows != 0) continue;
+        int gridColumns = worldSize / gridRows;
+
+        long tileRows = fileRows / gridRows;
+        long tileColumns = fileColumns / gridColumns;
+        if (tileRows < (long)patternRows - 1 || tileColumns < (long)patternColumns - 1 ||
+            tileRows == 0 || tileColumns == 0) {
+            continue; // halo would have to come from more than one neighbour
+        }
 
-    cout << "[" << worldRank << "] Requesting additional lines..." << endl;
-    if (worldRank + 1 >= worldSize) {
-        cout << "[" << worldRank << "] No next process to request lines from. Exiting." << endl;
-        // No next process to request lines from
-        return;
+        long cost = tileRows + tileColumns;
+        if (bestCost == -1 || cost < bestCost) {
+            bestCost = cost;
+            dims[0] = gridRows;
+            dims[1] = gridColumns;
+        }
     }
 
-    int nextProcess = worldRank + 1;
+    if (bestCost == -1) {
+        cerr << "Warning: input is too small to give every one of " << worldSize
+             << " processes a tile larger than the pattern." << endl;
+    }
+}
+
+//bytes of L2 cache available to one process, used to size the scan blocks
+long getL2CacheSize() {
+    long l2Size = 0;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    l2Size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    return l2Size > 0 ? l2Size : 256 * 1024; // common L2 size when the OS won't say
+}
+
+//exchanges `count` chars with two neighbours, sending to `dest` and receiving from `source`
+vector<char> exchangeHalo(vector<char>& sendBuffer, int dest, int source, int receiveCount, int tag, MPI_Comm cartComm) {
+    vector<char> receiveBuffer(source == MPI_PROC_NULL ? 0 : receiveCount);
+    int sendCount = dest == MPI_PROC_NULL ? 0 : static_cast<int>(sendBuffer.size());
+    MPI_Sendrecv(sendBuffer.data(), sendCount, MPI_CHAR, dest, tag,
+                 receiveBuffer.data(), static_cast<int>(receiveBuffer.size()), MPI_CHAR, source, tag,
+                 cartComm, MPI_STATUS_IGNORE);
+    return receiveBuffer;
+}
 
-    cout << "[" << worldRank << "] Sending request for " << neededLines << " lines to process " << nextProcess << endl;
+//rank of the tile at (row, col) in the process grid, or MPI_PROC_NULL when outside of it
+int neighborRank(MPI_Comm cartComm, const int* dims, int row, int col) {
+    if (row < 0 || row >= dims[0] || col < 0 || col >= dims[1]) {
+        return MPI_PROC_NULL;
+    }
+    int coords[2] = {row, col};
+    int rank;
+    MPI_Cart_rank(cartComm, coords, &rank);
+    return rank;
+}
 
-    // Non-blocking send to request lines
-    MPI_Ssend(&neededLines, 1, MPI_INT, nextProcess, 7, MPI_COMM_WORLD);
+//works out this rank's tile, its neighbours, and how much halo moves in each direction
+TileLayout getTileLayout(MPI_Comm cartComm, unsigned long fileRows, unsigned long fileColumns,
+                         unsigned long patternRows, unsigned long patternColumns) {
+    int dims[2];
+    int periods[2];
+    int coords[2];
+    MPI_Cart_get(cartComm, 2, dims, periods, coords);
+
+    TileLayout layout;
+    layout.rowOffset = blockStart(coords[0], dims[0], (int)fileRows);
+    layout.colOffset = blockStart(coords[1], dims[1], (int)fileColumns);
+    layout.ownedRows = blockStart(coords[0] + 1, dims[0], (int)fileRows) - layout.rowOffset;
+    layout.ownedCols = blockStart(coords[1] + 1, dims[1], (int)fileColumns) - layout.colOffset;
+
+    layout.up = neighborRank(cartComm, dims, coords[0] - 1, coords[1]);
+    layout.down = neighborRank(cartComm, dims, coords[0] + 1, coords[1]);
+    layout.left = neighborRank(cartComm, dims, coords[0], coords[1] - 1);
+    layout.right = neighborRank(cartComm, dims, coords[0], coords[1] + 1);
+    layout.upLeft = neighborRank(cartComm, dims, coords[0] - 1, coords[1] - 1);
+    layout.downRight = neighborRank(cartComm, dims, coords[0] + 1, coords[1] + 1);
+
+    // Halo sizes are clamped by the tile sizes so senders and receivers agree on counts
+    layout.haloRows = min((int)patternRows - 1, layout.ownedRows);
+    layout.haloCols = min((int)patternColumns - 1, layout.ownedCols);
+    layout.belowRows = 0;
+    layout.rightCols = 0;
+    if (layout.down != MPI_PROC_NULL) {
+        int belowTileRows = blockStart(coords[0] + 2, dims[0], (int)fileRows) - blockStart(coords[0] + 1, dims[0], (int)fileRows);
+        layout.belowRows = min((int)patternRows - 1, belowTileRows);
+    }
+    if (layout.right != MPI_PROC_NULL) {
+        int rightTileCols = blockStart(coords[1] + 2, dims[1], (int)fileColumns) - blockStart(coords[1] + 1, dims[1], (int)fileColumns);
+        layout.rightCols = min((int)patternColumns - 1, rightTileCols);
+    }
+    return layout;
+}
 
-    // Allocate and initialize buffer for receiving lines
-    const int maxLineSize = numColumns + 1;
-    char* buffer = new char[neededLines * maxLineSize];
-    memset(buffer, 0, neededLines * maxLineSize);
+//empty grid big enough for the tile and the halo it will receive
+LocalGrid allocateLocalGrid(const TileLayout& layout) {
+    LocalGrid grid;
+    grid.rowOffset = layout.rowOffset;
+    grid.colOffset = layout.colOffset;
+    grid.ownedRows = layout.ownedRows;
+    grid.ownedCols = layout.ownedCols;
+    grid.rows = layout.ownedRows + layout.belowRows;
+    grid.cols = layout.ownedCols + layout.rightCols;
+    grid.cells.assign((size_t)grid.rows * grid.cols, '\0');
+    return grid;
+}
 
-   MPI_Recv(buffer, neededLines * maxLineSize, MPI_CHAR, worldRank - 1, 10, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+//copies rows [rowBegin, rowEnd) x columns [colBegin, colEnd) of the grid into one buffer
+vector<char> packCells(const LocalGrid& grid, int rowBegin, int rowEnd, int colBegin, int colEnd) {
+    vector<char> buffer;
+    buffer.reserve((size_t)(rowEnd - rowBegin) * (colEnd - colBegin));
+    for (int r = rowBegin; r < rowEnd; r++) {
+        const char* row = &grid.cells[(size_t)r * grid.cols];
+        buffer.insert(buffer.end(), row + colBegin, row + colEnd);
+    }
+    return buffer;
+}
 
-    // Convert buffer to strings and assign to receivedLines
-    int bufferIndex = 0;
-    for (int i = 0; i < neededLines; i++) {
-        receivedLines[i].assign(&buffer[bufferIndex]);
-        bufferIndex += receivedLines[i].length() + 1; // Move past the current string and '\0'
+//inverse of packCells
+void unpackCells(LocalGrid& grid, const vector<char>& buffer, int rowBegin, int rowEnd, int colBegin, int colEnd) {
+    int width = colEnd - colBegin;
+    for (int r = rowBegin; r < rowEnd; r++) {
+        copy(buffer.begin() + (size_t)(r - rowBegin) * width, buffer.begin() + (size_t)(r - rowBegin + 1) * width,
+             grid.cells.begin() + (size_t)r * grid.cols + colBegin);
     }
+}
 
-    // Cleanup
-    delete[] buffer;
+//places received halos below, to the right of, and diagonally below-right of the tile
+void unpackHalos(LocalGrid& grid, const TileLayout& layout, const vector<char>& bottomHalo,
+                 const vector<char>& rightHalo, const vector<char>& cornerHalo) {
+    unpackCells(grid, bottomHalo, layout.ownedRows, grid.rows, 0, layout.ownedCols);
+    unpackCells(grid, rightHalo, 0, layout.ownedRows, layout.ownedCols, grid.cols);
+    if (layout.downRight != MPI_PROC_NULL) {
+        unpackCells(grid, cornerHalo, layout.ownedRows, grid.rows, layout.ownedCols, grid.cols);
+    }
 }
 
-void addCoords(string& outputCoords) {
-    // Output to file
-    ofstream outFile("/Users/austinfrank/Documents/GitHub/ParallelProcessing/Project3/output.txt");
-    outFile << outputCoords << endl;
-    outFile.close();
+/**
+ * Builds this rank's tile plus the halo it needs from its neighbours:
+ * the first (patternRows - 1) rows of the tile below, the first
+ * (patternColumns - 1) columns of the tile to the right, and the top-left
+ * corner of the tile diagonally below-right. Each rank sends the matching
+ * pieces of its own tile up, left, and up-left in the same step.
+ * This is the blocking path, used when the input rows are not all the same width.
+ */
+LocalGrid buildLocalGrid(string& fileName, MPI_Comm cartComm, const TileLayout& layout) {
+    LocalGrid grid = allocateLocalGrid(layout);
+    vector<string> tileLines = obtainTile(fileName, layout.rowOffset, layout.rowOffset + layout.ownedRows,
+                                          layout.colOffset, layout.colOffset + layout.ownedCols);
+    for (int r = 0; r < (int)tileLines.size(); r++) {
+        copy(tileLines[r].begin(), tileLines[r].end(), grid.cells.begin() + (size_t)r * grid.cols);
+    }
+
+    // Top rows go up, left columns go left, top-left corner goes up-left
+    vector<char> topRows = packCells(grid, 0, layout.haloRows, 0, layout.ownedCols);
+    vector<char> leftCols = packCells(grid, 0, layout.ownedRows, 0, layout.haloCols);
+    vector<char> corner = packCells(grid, 0, layout.haloRows, 0, layout.haloCols);
+
+    vector<char> bottomHalo = exchangeHalo(topRows, layout.up, layout.down, layout.belowRows * layout.ownedCols, 20, cartComm);
+    vector<char> rightHalo = exchangeHalo(leftCols, layout.left, layout.right, layout.ownedRows * layout.rightCols, 21, cartComm);
+    vector<char> cornerHalo = exchangeHalo(corner, layout.upLeft, layout.downRight, layout.belowRows * layout.rightCols, 22, cartComm);
+
+    unpackHalos(grid, layout, bottomHalo, rightHalo, cornerHalo);
+    return grid;
 }
 
-void convertAndGatherMasterCoords(const string& processCoords, int worldRank, int worldSize) {
-    // Convert masterCoords to a char array
-    char localCoords[MAX_COORD_LENGTH];
-    memset(localCoords, 0, MAX_COORD_LENGTH); // Initialize with zeros
-    strncpy(localCoords, processCoords.c_str(), MAX_COORD_LENGTH - 1); // Copy the string
+//bytes between the starts of consecutive input rows, or 0 when rows are not all the same width
+MPI_Offset getRowStride(MPI_File file, unsigned long fileRows, unsigned long fileColumns) {
+    MPI_Offset fileSize;
+    MPI_File_get_size(file, &fileSize);
+    for (MPI_Offset newlineBytes = 1; newlineBytes <= 2; newlineBytes++) { // "\n" or "\r\n"
+        MPI_Offset stride = fileColumns + newlineBytes;
+        MPI_Offset fullSize = stride * fileRows;
+        if (fileSize == fullSize || fileSize == fullSize - newlineBytes) { // last newline is optional
+            return stride;
+        }
+    }
+    return 0;
+}
 
-    // Allocate memory for gathering all coords at process 0
-    char* allCoords = nullptr;
-    if (worldRank == 0) {
-        allCoords = new char[MAX_COORD_LENGTH * worldSize];
+//brute-force compare of the pattern against the grid with its top-left corner at (i, j)
+bool matchesAt(const LocalGrid& grid, const vector<string>& patternMatch, int i, int j) {
+    for (size_t pi = 0; pi < patternMatch.size(); pi++) {
+        const char* gridRow = &grid.cells[(size_t)(i + pi) * grid.cols + j];
+        const string& patternRow = patternMatch[pi];
+        for (size_t pj = 0; pj < patternRow.length(); pj++) {
+            if (gridRow[pj] != patternRow[pj] && patternRow[pj] != PATTERN_WILDCARD) {
+                return false;
+            }
+        }
     }
+    return true;
+}
 
-    // Gather all localCoords to process 0
-    MPI_Gather(localCoords, MAX_COORD_LENGTH, MPI_CHAR, allCoords, MAX_COORD_LENGTH, MPI_CHAR, 0, MPI_COMM_WORLD);
+void recordMatch(const LocalGrid& grid, int i, int j, vector<MatchRecord>& matches) {
+    matches.push_back({grid.rowOffset + i + 1, grid.colOffset + j + 1, 0}); // 1-based global coords
+}
 
-    // Process 0 combines all gathered coords
-    if (worldRank == 0) {
-        string combinedCoords;
-        for (int i = 0; i < worldSize; ++i) {
-            combinedCoords += string(allCoords + i * MAX_COORD_LENGTH) + " ";
+//tries every top-left offset in [rowBegin, rowEnd) x [colBegin, colEnd) with a full compare
+void scanBruteForce(const LocalGrid& grid, const vector<string>& patternMatch,
+                    int rowBegin, int rowEnd, int colBegin, int colEnd, vector<MatchRecord>& matches) {
+    for (int i = rowBegin; i < rowEnd; i++) {
+        for (int j = colBegin; j < colEnd; j++) {
+            if (matchesAt(grid, patternMatch, i, j)) {
+                recordMatch(grid, i, j, matches);
+            }
         }
-        addCoords(combinedCoords); // Assuming addCoords can take a std::string
-        cout << "AlL THE COORDS: " << combinedCoords << endl;
+    }
+}
 
-        delete[] allCoords;
+//bases for the row and column polynomial hashes (arithmetic wraps mod 2^64)
+const uint64_t ROW_HASH_BASE = 0x100000001B3ULL;
+const uint64_t COLUMN_HASH_BASE = 0x9E3779B97F4A7C15ULL;
+
+uint64_t power(uint64_t base, unsigned long exponent) {
+    uint64_t result = 1;
+    for (unsigned long i = 0; i < exponent; i++) {
+        result *= base;
+    }
+    return result;
+}
+
+/**
+ * 2D Rabin-Karp over the same offsets as scanBruteForce.
+ * Each grid row gets a sliding hash of every patternColumns-wide window, and
+ * those row hashes are then rolled down over patternRows rows, so each offset
+ * costs O(1) amortized. Only offsets whose hash equals the pattern hash are
+ * compared cell by cell.
+ */
+void scanRollingHash(const LocalGrid& grid, const vector<string>& patternMatch,
+                     int rowBegin, int rowEnd, int colBegin, int colEnd, vector<MatchRecord>& matches) {
+    size_t patternRows = patternMatch.size();
+    size_t patternColumns = patternMatch[0].length();
+    int width = colEnd - colBegin;
+    if (width <= 0 || rowEnd <= rowBegin) return;
+
+    uint64_t rowLeadPower = power(ROW_HASH_BASE, patternColumns - 1);
+    uint64_t columnLeadPower = power(COLUMN_HASH_BASE, patternRows - 1);
+
+    // Hash of the pattern, built the same way as the grid hashes
+    uint64_t patternHash = 0;
+    for (size_t pi = 0; pi < patternRows; pi++) {
+        uint64_t rowHash = 0;
+        for (size_t pj = 0; pj < patternColumns; pj++) {
+            rowHash = rowHash * ROW_HASH_BASE + (unsigned char)patternMatch[pi][pj];
+        }
+        patternHash = patternHash * COLUMN_HASH_BASE + rowHash;
+    }
+
+    // Row hashes of the last patternRows grid rows, kept as a ring
+    vector<uint64_t> rowHashes(patternRows * width);
+    vector<uint64_t> columnHashes(width, 0);
+
+    auto hashRow = [&](int gridRow, uint64_t* out) {
+        const char* cells = &grid.cells[(size_t)gridRow * grid.cols + colBegin];
+        uint64_t hash = 0;
+        for (size_t pj = 0; pj < patternColumns; pj++) {
+            hash = hash * ROW_HASH_BASE + (unsigned char)cells[pj];
+        }
+        out[0] = hash;
+        for (int j = 1; j < width; j++) {
+            hash = (hash - rowLeadPower * (unsigned char)cells[j - 1]) * ROW_HASH_BASE
+                   + (unsigned char)cells[j + patternColumns - 1];
+            out[j] = hash;
+        }
+    };
+
+    // Prime the column hashes with the first patternRows - 1 rows
+    for (size_t pi = 0; pi + 1 < patternRows; pi++) {
+        uint64_t* ring = &rowHashes[pi * width];
+        hashRow(rowBegin + (int)pi, ring);
+        for (int j = 0; j < width; j++) {
+            columnHashes[j] = columnHashes[j] * COLUMN_HASH_BASE + ring[j];
+        }
+    }
+
+    for (int i = rowBegin; i < rowEnd; i++) {
+        // Bring in the bottom row of the window at offset i
+        size_t newSlot = (i - rowBegin + patternRows - 1) % patternRows;
+        uint64_t* newest = &rowHashes[newSlot * width];
+        hashRow(i + (int)patternRows - 1, newest);
+        for (int j = 0; j < width; j++) {
+            columnHashes[j] = columnHashes[j] * COLUMN_HASH_BASE + newest[j];
+        }
+
+        for (int j = 0; j < width; j++) {
+            if (columnHashes[j] == patternHash && matchesAt(grid, patternMatch, i, colBegin + j)) {
+                recordMatch(grid, i, colBegin + j, matches);
+            }
+        }
+
+        // Drop the top row of the window before moving down
+        const uint64_t* oldest = &rowHashes[((i - rowBegin) % patternRows) * width];
+        for (int j = 0; j < width; j++) {
+            columnHashes[j] -= columnLeadPower * oldest[j];
+        }
+    }
+}
+
+/**
+ * Bit-parallel (Shift-And) matcher for patterns up to 64 columns wide.
+ * Every distinct pattern row gets one 64-bit mask per byte value, with bit pj
+ * set when column pj holds that byte or the wildcard. A single pass over a
+ * grid row then yields, as a bitset over start columns, where that pattern row
+ * matches. Wildcards are folded into every mask, so they cost nothing extra.
+ * The bitsets of rows i..i+patternRows-1 are ANDed, stopping early once no
+ * candidate column is left, and are memoized per (grid row, pattern row).
+ */
+void scanBitParallel(const LocalGrid& grid, const vector<string>& patternMatch,
+                     int rowBegin, int rowEnd, int colBegin, int colEnd, vector<MatchRecord>& matches) {
+    size_t patternRows = patternMatch.size();
+    size_t patternColumns = patternMatch[0].length();
+    int width = colEnd - colBegin;
+    if (width <= 0 || rowEnd <= rowBegin) return;
+
+    // Identical pattern rows share one set of masks and one memo entry
+    vector<string> distinctRows;
+    vector<int> rowIds(patternRows);
+    for (size_t pi = 0; pi < patternRows; pi++) {
+        auto found = find(distinctRows.begin(), distinctRows.end(), patternMatch[pi]);
+        rowIds[pi] = (int)(found - distinctRows.begin());
+        if (found == distinctRows.end()) {
+            distinctRows.push_back(patternMatch[pi]);
+        }
+    }
+
+    vector<uint64_t> masks(distinctRows.size() * 256, 0);
+    for (size_t id = 0; id < distinctRows.size(); id++) {
+        uint64_t* rowMasks = &masks[id * 256];
+        for (size_t pj = 0; pj < patternColumns; pj++) {
+            unsigned char symbol = distinctRows[id][pj];
+            if (symbol == (unsigned char)PATTERN_WILDCARD) {
+                for (int c = 0; c < 256; c++) {
+                    rowMasks[c] |= 1ULL << pj;
+                }
+            } else {
+                rowMasks[symbol] |= 1ULL << pj;
+            }
+        }
+    }
+
+    int words = (width + 63) / 64;
+    int memoRows = rowEnd - rowBegin + (int)patternRows - 1;
+    vector<uint64_t> rowMatches((size_t)memoRows * distinctRows.size() * words);
+    vector<char> computed((size_t)memoRows * distinctRows.size(), 0);
+    uint64_t acceptBit = 1ULL << (patternColumns - 1);
+
+    auto getRowMatch = [&](int memoRow, int id) -> const uint64_t* {
+        size_t slot = (size_t)memoRow * distinctRows.size() + id;
+        uint64_t* bits = &rowMatches[slot * words];
+        if (!computed[slot]) {
+            const unsigned char* cells = (const unsigned char*)&grid.cells[(size_t)(rowBegin + memoRow) * grid.cols + colBegin];
+            const uint64_t* rowMasks = &masks[(size_t)id * 256];
+            fill(bits, bits + words, 0);
+            uint64_t state = 0;
+            int scanLength = width + (int)patternColumns - 1;
+            for (int k = 0; k < scanLength; k++) {
+                state = ((state << 1) | 1) & rowMasks[cells[k]];
+                if (state & acceptBit) {
+                    int start = k - (int)patternColumns + 1;
+                    bits[start / 64] |= 1ULL << (start % 64);
+                }
+            }
+            computed[slot] = 1;
+        }
+        return bits;
+    };
+
+    vector<uint64_t> candidates(words);
+    for (int i = rowBegin; i < rowEnd; i++) {
+        fill(candidates.begin(), candidates.end(), ~0ULL);
+        if (width % 64 != 0) {
+            candidates[words - 1] = (1ULL << (width % 64)) - 1;
+        }
+
+        bool anyLeft = true;
+        for (size_t pi = 0; pi < patternRows && anyLeft; pi++) {
+            const uint64_t* bits = getRowMatch(i - rowBegin + (int)pi, rowIds[pi]);
+            anyLeft = false;
+            for (int w = 0; w < words; w++) {
+                candidates[w] &= bits[w];
+                anyLeft |= candidates[w] != 0;
+            }
+        }
+
+        for (int w = 0; w < words && anyLeft; w++) {
+            for (uint64_t word = candidates[w]; word != 0; word &= word - 1) {
+                recordMatch(grid, i, colBegin + w * 64 + __builtin_ctzll(word), matches);
+            }
+        }
+    }
+}
+
+bool hasWildcard(const vector<string>& patternMatch) {
+    for (const string& row : patternMatch) {
+        if (row.find(PATTERN_WILDCARD) != string::npos) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//resolves MATCH_AUTO to a concrete matcher from the pattern's shape
+MatchMode chooseMatchMode(MatchMode requested, const vector<string>& patternMatch) {
+    bool fitsInWord = patternMatch[0].length() <= BIT_PARALLEL_MAX_COLUMNS;
+    bool wildcards = hasWildcard(patternMatch);
+
+    if (requested == MATCH_BIT_PARALLEL && !fitsInWord) {
+        requested = MATCH_AUTO;
+    }
+    if (requested == MATCH_ROLLING_HASH && wildcards) {
+        requested = MATCH_AUTO; // a hash can't skip don't-care cells
+    }
+    if (requested != MATCH_AUTO) {
+        return requested;
+    }
+
+    unsigned long patternArea = patternMatch.size() * patternMatch[0].length();
+    if (!wildcards && patternArea >= ROLLING_HASH_MIN_AREA) {
+        return MATCH_ROLLING_HASH;
+    }
+    return fitsInWord ? MATCH_BIT_PARALLEL : MATCH_BRUTE_FORCE;
+}
+
+//function signature shared by all the matchers
+typedef void (*ScanFunction)(const LocalGrid&, const vector<string>&, int, int, int, int, vector<MatchRecord>&);
+
+//runs scanBlock over [rowBegin, rowEnd) x [colBegin, colEnd) in blockRows x blockCols pieces
+void scanRegion(ScanFunction scanBlock, const LocalGrid& grid, const vector<string>& patternMatch,
+                int rowBegin, int rowEnd, int colBegin, int colEnd, int blockRows, int blockCols) {
+    for (int blockRow = rowBegin; blockRow < rowEnd; blockRow += blockRows) {
+        for (int blockCol = colBegin; blockCol < colEnd; blockCol += blockCols) {
+            scanBlock(grid, patternMatch, blockRow, min(blockRow + blockRows, rowEnd),
+                      blockCol, min(blockCol + blockCols, colEnd), masterMatches);
+        }
+    }
+}
+
+/**
+ * Pipelined tile search over rows of equal width.
+ * The halo receives are posted up front. The tile is then read in stripes
+ * with nonblocking MPI-IO, and stripe k+1 is in flight while stripe k is
+ * scanned, so I/O, halo traffic and compute overlap. Each stripe scan covers
+ * only offsets whose window is already in memory and clear of the right halo.
+ * Once the halos land, the right band and bottom rows are scanned.
+ */
+void scanTilePipelined(MPI_File file, MPI_Comm cartComm, MPI_Offset rowStride, unsigned long fileRows, const TileLayout& layout,
+                       LocalGrid& grid, const vector<string>& patternMatch, ScanFunction scanBlock,
+                       int blockRows, int blockCols) {
+    int patternRows = (int)patternMatch.size();
+    int patternColumns = (int)patternMatch[0].length();
+
+    // Post halo receives first so they arrive while this rank reads and scans
+    vector<char> bottomHalo((size_t)layout.belowRows * layout.ownedCols);
+    vector<char> rightHalo((size_t)layout.ownedRows * layout.rightCols);
+    vector<char> cornerHalo((size_t)layout.belowRows * layout.rightCols);
+    MPI_Request haloReceives[3];
+    MPI_Irecv(bottomHalo.data(), (int)bottomHalo.size(), MPI_CHAR, layout.down, 20, cartComm, &haloReceives[0]);
+    MPI_Irecv(rightHalo.data(), (int)rightHalo.size(), MPI_CHAR, layout.right, 21, cartComm, &haloReceives[1]);
+    MPI_Irecv(cornerHalo.data(), (int)cornerHalo.size(), MPI_CHAR, layout.downRight, 22, cartComm, &haloReceives[2]);
+
+    // View the file as just this rank's tile so each stripe is one contiguous range of it
+    int sizes[2] = {(int)fileRows, (int)rowStride};
+    int subsizes[2] = {layout.ownedRows, layout.ownedCols};
+    int starts[2] = {layout.rowOffset, layout.colOffset};
+    MPI_Datatype tileType;
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_CHAR, &tileType);
+    MPI_Type_commit(&tileType);
+    MPI_File_set_view(file, 0, MPI_CHAR, tileType, "native", MPI_INFO_NULL);
+
+    // A stripe fills about half of L2 so it is still cached when scanned
+    int stripeRows = max(patternRows, (int)(getL2CacheSize() / 2 / max(grid.cols, 1)));
+    int stripeCount = (layout.ownedRows + stripeRows - 1) / stripeRows;
+
+    // Reads land straight in the grid; the memory type skips the right halo columns
+    auto postStripeRead = [&](int stripe, MPI_Request* request) {
+        int firstRow = stripe * stripeRows;
+        int rowCount = min(stripeRows, layout.ownedRows - firstRow);
+        MPI_Datatype stripeType;
+        MPI_Type_vector(rowCount, layout.ownedCols, grid.cols, MPI_CHAR, &stripeType);
+        MPI_Type_commit(&stripeType);
+        MPI_File_iread_at(file, (MPI_Offset)firstRow * layout.ownedCols, &grid.cells[(size_t)firstRow * grid.cols],
+                          1, stripeType, request);
+        MPI_Type_free(&stripeType);
+    };
+
+    int lastRow = min(layout.ownedRows, grid.rows - patternRows + 1);
+    int lastCol = min(layout.ownedCols, grid.cols - patternColumns + 1);
+    int interiorCols = max(0, min(lastCol, layout.ownedCols - patternColumns + 1));
+
+    vector<char> topRows;
+    vector<char> corner;
+    vector<char> leftCols;
+    MPI_Request haloSends[3] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+
+    MPI_Request readRequest;
+    postStripeRead(0, &readRequest);
+    int scannedRows = 0;
+    for (int stripe = 0; stripe < stripeCount; stripe++) {
+        MPI_Wait(&readRequest, MPI_STATUS_IGNORE);
+        int rowsRead = min(layout.ownedRows, (stripe + 1) * stripeRows);
+        if (stripe + 1 < stripeCount) {
+            postStripeRead(stripe + 1, &readRequest);
+        }
+
+        // Neighbours above only need our first rows, so ship them as soon as they are in
+        if (haloSends[0] == MPI_REQUEST_NULL && rowsRead >= layout.haloRows) {
+            topRows = packCells(grid, 0, layout.haloRows, 0, layout.ownedCols);
+            corner = packCells(grid, 0, layout.haloRows, 0, layout.haloCols);
+            MPI_Isend(topRows.data(), (int)topRows.size(), MPI_CHAR, layout.up, 20, cartComm, &haloSends[0]);
+            MPI_Isend(corner.data(), (int)corner.size(), MPI_CHAR, layout.upLeft, 22, cartComm, &haloSends[1]);
+        }
+
+        int scanEnd = max(scannedRows, min(lastRow, rowsRead - patternRows + 1));
+        scanRegion(scanBlock, grid, patternMatch, scannedRows, scanEnd, 0, interiorCols, blockRows, blockCols);
+        scannedRows = scanEnd;
     }
+
+    // The left neighbour needs a column strip from every row, so it goes once the whole tile is in
+    leftCols = packCells(grid, 0, layout.ownedRows, 0, layout.haloCols);
+    MPI_Isend(leftCols.data(), (int)leftCols.size(), MPI_CHAR, layout.left, 21, cartComm, &haloSends[2]);
+
+    MPI_Waitall(3, haloReceives, MPI_STATUSES_IGNORE);
+    unpackHalos(grid, layout, bottomHalo, rightHalo, cornerHalo);
+
+    // Right band of the rows already scanned, then everything left at the bottom
+    scanRegion(scanBlock, grid, patternMatch, 0, scannedRows, interiorCols, lastCol, blockRows, blockCols);
+    scanRegion(scanBlock, grid, patternMatch, scannedRows, lastRow, 0, lastCol, blockRows, blockCols);
+
+    MPI_Waitall(3, haloSends, MPI_STATUSES_IGNORE);
+    MPI_Type_free(&tileType);
 }
+
 /**
  *
- * @param numThreads
  * @param fileName
- * @param mainTable
+ * @param cartComm 2D Cartesian communicator of tiles
+ * @param fileRows, fileColumns size of the input grid
+ * @param patternMatch pattern to search for
+ * @param matchMode brute force, rolling hash, bit-parallel, or picked from the pattern
  *
  * Steps:
- * 1. assign each mpi a certain amount of lines
- * 2. parse each row to find a pattern for that row, if match, index same spot in next row
- * 3. if next row isnt within bounds of mpi rank, pass index to next in
- *    line (index being column num and row++)
- * 4. if match, add to output list
+ * 1. each rank reads its tile of the input in stripes while swapping halos with its neighbours
+ * 2. scan every top-left offset owned by the tile as its rows arrive, block by
+ *    block so a block plus its halo stays within L2
+ * 3. if match, add to output list
+ * 4. gather all matches at process 0
  *
  */
+void dispatchMPI(string& fileName, MPI_Comm cartComm, unsigned long fileRows, unsigned long fileColumns,
+                 vector<string>& patternMatch, MatchMode matchMode) {
+    int worldRank;
+    int worldSize;
+    int dims[2];
+    int periods[2];
+    int coords[2];
+    MPI_Comm_rank(cartComm, &worldRank);
+    MPI_Comm_size(cartComm, &worldSize);
+    MPI_Cart_get(cartComm, 2, dims, periods, coords);
+
+    unsigned long patternRows = patternMatch.size();
+    unsigned long patternColumns = patternMatch[0].length();
+    TileLayout layout = getTileLayout(cartComm, fileRows, fileColumns, patternRows, patternColumns);
+    LocalGrid grid = allocateLocalGrid(layout);
+
+    cout << "RANK: " << worldRank << " ROWS: " << grid.rowOffset << "-" << grid.rowOffset + grid.ownedRows
+         << " COLS: " << grid.colOffset << "-" << grid.colOffset + grid.ownedCols << endl;
+
+    // Last top-left offsets that still leave room for the whole pattern
+    int lastRow = min(grid.ownedRows, grid.rows - (int)patternRows + 1);
+    int lastCol = min(grid.ownedCols, grid.cols - (int)patternColumns + 1);
+
+    // Size scan blocks so a block and its halo fit in L2
+    long l2Size = getL2CacheSize();
+    int blockCols = max(1, min(lastCol, 512));
+    long bytesPerBlockRow = blockCols + (long)patternColumns - 1;
+    int blockRows = max(1, (int)(l2Size / 2 / bytesPerBlockRow) - (int)patternRows + 1);
+
+    matchMode = chooseMatchMode(matchMode, patternMatch);
+    ScanFunction scanBlock = scanBruteForce;
+    if (matchMode == MATCH_ROLLING_HASH) {
+        scanBlock = scanRollingHash;
+    } else if (matchMode == MATCH_BIT_PARALLEL) {
+        scanBlock = scanBitParallel;
+    }
 
-void dispatchMPI(string& fileName, int worldRank, int worldSize, int startRow, int endRow, int numColumns, string* patternMatch,unsigned long rowLength) {
-
-    int counter = 0;
-    string* processLines = new string[endRow - startRow + 1];
-    processLines = obtainLines(startRow, endRow, worldRank, fileName, processLines);
-
-    size_t columnLength = patternMatch[0].length();
-    string coordOutput;
-    int topRow = 0;
-    int topCol = 0;
-    int receivedLines;
-    int needLines = 0;
-    bool rowNotRequested = true;
-
-    cout << "RANK: " << worldRank << " START: " << startRow << " END: " << endRow << endl;
-    for (int i = 0; i < endRow - startRow; i++) {
-        for (int j = 0; j < numColumns - columnLength; j++) {
-            bool patternFound = true;
-            bool patternComplete = false;
-
-            for (size_t pi = 0; pi < rowLength && patternFound; pi++) {
-                for (size_t pj = 0; pj < columnLength && patternFound; pj++) {
-                    int currentRow = i + pi;
-
-                    if (currentRow < endRow - startRow + 1) {
-                        if (processLines[currentRow][j + pj] == patternMatch[pi][pj]) {
-                            if (pi == 0 && pj == 0) { // Note top-left corner of pattern match
-                                topRow = i + 1; // Adjust for 1-based indexing
-                                topCol = j + 1;
-                                patternFound = true;
-                            }
-                            if (pi == rowLength - 1 && pj == columnLength - 1) {
-                                patternComplete = true; //full pattern found
-                            }
-                        } else {
-                            patternFound = false;
-                            //break; // Exit the inner loop on first mismatch
-                        }
-                    } else {
-                        patternFound = false;
-                       // break; // Not enough lines for the pattern
-                    }
-
-                    //any process other than the first
-                    if(worldRank != 0  && i == int((endRow - startRow) - 1) && rowNotRequested) {
-                        counter++;
-
-                        cout << "RANK " << worldRank << " RECV PEND " << counter << " ====" << endl;
-                        MPI_Recv(&needLines, 1, MPI_INT, worldRank - 1, 18, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                      //  cout << "PROCESS " << worldRank << " RECV STATUS (18) : " << statuss <<  endl;
-                        cout << "RANK " << worldRank << " RECV COMPLETE " << counter << " ========== " << endl;
-                        rowNotRequested = false;
-                        if(needLines == 1)
-                        {
-                            cout << "[" << worldRank - 1 << "] NEEDS LINES. Preparing to send request." << endl;
-
-                            MPI_Recv(&receivedLines, 1, MPI_INT, worldRank - 1, 7, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                            cout << "[" << worldRank << "] received request." << endl;
-
-                            int totalSize = 0;
-                            for (int index = 0; index < receivedLines; index++) {
-                                totalSize += processLines[index].length() + 1; // +1 for '\n' or '\0'
-                            }
-                            //  cout << "Total Size: " << totalSize << endl;
-
-                            char *sendLines = new char[totalSize + 1]; // +1 for final null terminator
-                            sendLines[0] = '\0'; // Initialize the buffer
-
-                            int currentPosition = 0;
-                            for (int index = 0; index < receivedLines; index++) {
-                                strcpy(sendLines + currentPosition, processLines[index].c_str());
-                                currentPosition += processLines[index].length();
-                                sendLines[currentPosition] = '\n'; // Add newline as separator
-                                currentPosition++; // Move past the newline
-                            }
-                            sendLines[currentPosition - 1] = '\0'; // Replace last '\n' with null terminator if needed
-                            cout << "[" << worldRank << "] SENDING Lines." << endl;
-                            MPI_Ssend(sendLines, currentPosition, MPI_CHAR, worldRank - 1, 10, MPI_COMM_WORLD);
-                            cout << "[" << worldRank << "] SENDING Lines COMPLETE." << endl;
-
-
-
-                            delete[] sendLines;
-
-                            needLines = 0;
-                        }
-                    }
-                    //No more rows and pattern not complete
-                    //Request more rows if not last Process
-                    if (worldRank != worldSize - 1) {
-                        if(patternFound && !patternComplete &&
-                        i == (endRow - startRow) && pi < rowLength - 1
-                        && rowNotRequested) { // Handle pattern extending beyond current chunk
-                            cout << "WORLD RANK: " << worldRank << " PI: " << pi << " PJ: " << pj << endl;
-                            needLines = 1; //true
-                         //   cout << "SEND PENDING!" << endl;
-                            MPI_Send(&needLines, 1, MPI_INT, worldRank + 1, 18, MPI_COMM_WORLD);
-                          //  cout << "SEND COMPLETE!" << endl;
-                          rowNotRequested = false;
-
-                            int neededLines = rowLength - pi;
-                            string* additionalLines = new string[neededLines]; // Corrected variable name
-                            requestAdditionalLines(neededLines, worldRank, worldSize, numColumns, additionalLines);
-                            for (int extraLine = 0; extraLine < neededLines && patternFound; extraLine++, currentRow++) {
-                                for (size_t extraChar = 0; extraChar < columnLength && patternFound; extraChar++) {
-                                    if (additionalLines[extraLine][j + extraChar] != patternMatch[pi + extraLine][extraChar]) {
-                                        patternFound = false;
-                                    }
-                                }
-                            }
-                            if(patternFound)
-                            {
-                                patternComplete = true;
-                            }
-                            delete[] additionalLines; // Ensure to delete after use within each pattern checking iteration
-                        }
-                        else if((patternFound && patternComplete) ||
-                                !patternFound){
-                            needLines = 0;
-                            MPI_Send(&needLines, 1, MPI_INT, worldRank + 1, 18, MPI_COMM_WORLD);
-                            rowNotRequested = false;
-                        }
-                    }
-                }
-            }
-            if (patternFound && patternComplete) {
-                coordOutput = to_string(startRow + topRow) + "," + to_string(topCol) + "\n"; // Corrected global row index calculation
-                //cout << "adding coords: " << coordOutput << endl;
-                masterCoords += coordOutput;
-                cout << "[" << worldRank << "] Pattern found. Adding coordinates: " << coordOutput << endl;
-            }
-        }
+    MPI_File file;
+    MPI_File_open(cartComm, fileName.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file);
+    MPI_Offset rowStride = getRowStride(file, fileRows, fileColumns);
+
+    // Every rank takes the same branch: the stride comes from the shared file size
+    bool tilesNonEmpty = fileRows >= (unsigned long)dims[0] && fileColumns >= (unsigned long)dims[1];
+    if (rowStride != 0 && tilesNonEmpty) {
+        scanTilePipelined(file, cartComm, rowStride, fileRows, layout, grid, patternMatch, scanBlock, blockRows, blockCols);
+    } else {
+        grid = buildLocalGrid(fileName, cartComm, layout);
+        scanRegion(scanBlock, grid, patternMatch, 0, lastRow, 0, lastCol, blockRows, blockCols);
     }
-    cout << "[" << worldRank << "] Finished processing. Adding coords if applicable." << endl;
-    convertAndGatherMasterCoords(masterCoords, worldRank, worldSize);
+    MPI_File_close(&file);
 
-    cout << "[" << worldRank << "] Process complete. Cleaning up." << endl;
-    delete[] processLines; // Clean up after processing all lines
+    const char* modeNames[] = {"auto", "brute force", "rolling hash", "bit-parallel"};
+    cout << "[" << worldRank << "] Finished processing with " << modeNames[matchMode]
+         << ", found " << masterMatches.size() << " matches." << endl;
+    gatherMatches(masterMatches, worldRank, worldSize);
 }
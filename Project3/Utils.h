@@ -1,19 +1,83 @@
 #include <chrono>
 #include <iostream>
 #include <fstream>
+#include <vector>
+#include <cstdint>
+#include "/usr/local/Cellar/open-mpi/5.0.2/include/mpi.h"
 
 using namespace std;
 
 #ifndef PARALLELPROCESSING_UTILS_H
 #define PARALLELPROCESSING_UTILS_H
 
-void dispatchMPI(string& fileName, int worldRank, int worldSize,  int startRow, int endRow, int numColumns, string* patternMatch, unsigned long patternRows);
+//one pattern hit, top-left corner in 1-based global coordinates
+struct MatchRecord {
+    int row;
+    int col;
+    int patternId;
+};
+
+//one rank's tile of the input plus the halo rows/columns borrowed from its neighbours
+struct LocalGrid {
+    vector<char> cells; // row-major, rows x cols
+    int rows = 0;
+    int cols = 0;
+    int ownedRows = 0; // tile size without halo
+    int ownedCols = 0;
+    int rowOffset = 0; // global position of the tile's top-left cell
+    int colOffset = 0;
+};
+
+//how each offset is compared against the pattern
+enum MatchMode {
+    MATCH_AUTO,         // rolling hash for large exact patterns, otherwise bit-parallel when it fits
+    MATCH_BRUTE_FORCE,
+    MATCH_ROLLING_HASH,
+    MATCH_BIT_PARALLEL
+};
+
+const unsigned long ROLLING_HASH_MIN_AREA = 64; // pattern cells
+const unsigned long BIT_PARALLEL_MAX_COLUMNS = 64; // one mask bit per pattern column
+const char PATTERN_WILDCARD = '?'; // pattern cell that matches any byte
+
+//this rank's place in the process grid and the halo it trades with each neighbour
+struct TileLayout {
+    int rowOffset = 0; // global position and size of the owned tile
+    int colOffset = 0;
+    int ownedRows = 0;
+    int ownedCols = 0;
+    int haloRows = 0;  // rows/columns of this tile the neighbours above and to the left need
+    int haloCols = 0;
+    int belowRows = 0; // halo received from the tiles below and to the right
+    int rightCols = 0;
+    int up = MPI_PROC_NULL;
+    int down = MPI_PROC_NULL;
+    int left = MPI_PROC_NULL;
+    int right = MPI_PROC_NULL;
+    int upLeft = MPI_PROC_NULL;
+    int downRight = MPI_PROC_NULL;
+};
+
+void dispatchMPI(string& fileName, MPI_Comm cartComm, unsigned long fileRows, unsigned long fileColumns,
+                 vector<string>& patternMatch, MatchMode matchMode);
 void getNumColumnRow(string& fileName, unsigned long& numColumns, unsigned long& numRows);
-void processPattern(string& patternName, unsigned long& numColumns, unsigned long& numRows, string* patternMatch);
-char** requestAdditionalLines(int neededLines, int worldRank, int worldSize, int numColumns, int& receivedLines);
-void handleEdgeCases(int worldRank, int worldSize, int rowIndex, int rowLength, int numColumns);
+void processPattern(string& patternName, unsigned long& numColumns, unsigned long& numRows, vector<string>& patternMatch);
+void chooseProcessGrid(int worldSize, unsigned long fileRows, unsigned long fileColumns,
+                       unsigned long patternRows, unsigned long patternColumns, int* dims);
+TileLayout getTileLayout(MPI_Comm cartComm, unsigned long fileRows, unsigned long fileColumns,
+                         unsigned long patternRows, unsigned long patternColumns);
+LocalGrid allocateLocalGrid(const TileLayout& layout);
+LocalGrid buildLocalGrid(string& fileName, MPI_Comm cartComm, const TileLayout& layout);
+MatchMode chooseMatchMode(MatchMode requested, const vector<string>& patternMatch);
+void scanBruteForce(const LocalGrid& grid, const vector<string>& patternMatch,
+                    int rowBegin, int rowEnd, int colBegin, int colEnd, vector<MatchRecord>& matches);
+void scanRollingHash(const LocalGrid& grid, const vector<string>& patternMatch,
+                     int rowBegin, int rowEnd, int colBegin, int colEnd, vector<MatchRecord>& matches);
+void scanBitParallel(const LocalGrid& grid, const vector<string>& patternMatch,
+                     int rowBegin, int rowEnd, int colBegin, int colEnd, vector<MatchRecord>& matches);
 void addCoords(string& outputCoords);
-string* obtainLines(int startRow, int endRow, int worldRank, string& fileName,  string* processLines);
+void gatherMatches(const vector<MatchRecord>& processMatches, int worldRank, int worldSize);
+vector<string> obtainTile(string& fileName, int rowStart, int rowEnd, int colStart, int colEnd);
 
 
 #endif //PARALLELPROCESSING_UTILS_H
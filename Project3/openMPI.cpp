@@ -5,18 +5,30 @@
 
 using namespace std;
 
-int main() {
+int main(int argc, char* argv[]) {
     cout << "using openMPI!!!" << endl;
     string fileName = "/Users/austinfrank/Documents/GitHub/ParallelProcessing/Project3/input.txt";
     string patternName = "/Users/austinfrank/Documents/GitHub/ParallelProcessing/Project3/pattern.txt";
     string line;
-    string* patternMatch = new string[10];
+    vector<string> patternMatch;
+    MatchMode matchMode = MATCH_AUTO;
 
     unsigned long fileColumns = 0;
     unsigned long fileRows = 0;
     unsigned long patternColumns = 0;
     unsigned long patternRows = 0;
-    int rowsPerProcess = 0;
+
+    // Optional matcher override: --brute, --hash or --bits
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--brute") {
+            matchMode = MATCH_BRUTE_FORCE;
+        } else if (arg == "--hash") {
+            matchMode = MATCH_ROLLING_HASH;
+        } else if (arg == "--bits") {
+            matchMode = MATCH_BIT_PARALLEL;
+        }
+    }
 
     //init MPI vars
     MPI_Init(NULL, NULL);
@@ -24,24 +36,32 @@ int main() {
     int worldRank;
     MPI_Comm_rank(MPI_COMM_WORLD, &worldRank);
     MPI_Comm_size(MPI_COMM_WORLD, &worldSize);
-    string mpiChunks[worldSize];
 
     getNumColumnRow(fileName, fileColumns, fileRows);
    // getNumColumnRow(patternFile, patternColumns, patternRows);
     processPattern(patternName, patternColumns, patternRows, patternMatch);
-
-    rowsPerProcess = fileRows / worldSize;
-    int startRow = worldRank * rowsPerProcess;
-    int endRow = (worldRank + 1) * rowsPerProcess;
-   // cout << "PROCESS: " << worldRank << " start row: " << startRow << " end row: " << endRow << endl;
-   // cout << "Pattern rows: " << patternRows << " Pattern Columns: " << patternColumns << endl;
-    // Adjust the range for the last process to include any remaining rows
-    if (worldRank == worldSize - 1) {
-        endRow += fileRows % worldSize;
+    // Every matcher reads patternMatch[0], so a missing or empty pattern can't go any further.
+    // All ranks read the same file and agree; rank 0 reports it before the abort
+    if (patternRows == 0 || patternColumns == 0) {
+        if (worldRank == 0) {
+            cerr << "Error: pattern file " << patternName << " is missing or empty." << endl;
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Abort(MPI_COMM_WORLD, 1);
     }
 
+    // Split the grid into 2D tiles, one per process
+    int dims[2];
+    int periods[2] = {0, 0};
+    chooseProcessGrid(worldSize, fileRows, fileColumns, patternRows, patternColumns, dims);
+    MPI_Comm cartComm;
+    MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 0, &cartComm);
+    if (worldRank == 0) {
+        cout << "Process grid: " << dims[0] << " x " << dims[1] << endl;
+    }
 
-    dispatchMPI(fileName, worldRank, worldSize, startRow, endRow, fileColumns, patternMatch, patternRows);
+    dispatchMPI(fileName, cartComm, fileRows, fileColumns, patternMatch, matchMode);
+    MPI_Comm_free(&cartComm);
     cout << "FINALIZING" << endl;
     MPI_Finalize();
     cout <<"Finalized!" << endl;
@@ -0,0 +1,20 @@
+#!/bin/sh
+# The pipelined counter must exit nonzero when its input can't be read, with the
+# io_uring block reader, with O_DIRECT, and with the plain reader threads. A
+# directory opens fine but fails on the first read, the way a bad file would.
+# Usage: pipelineReadFailure.sh <openMP binary>
+counter="$1"
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir"
+mkdir unreadable
+
+status=0
+for mode in "--io-uring" "--direct" "--pipeline 1,2,2"; do
+    if "$counter" unreadable $mode > log.txt 2>&1; then
+        echo "exit status 0 for an unreadable input with $mode"
+        cat log.txt
+        status=1
+    fi
+done
+exit $status
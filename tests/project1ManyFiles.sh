@@ -0,0 +1,23 @@
+#!/bin/sh
+# Submits many tiny files back to back to the Project1 thread pool. Each job is
+# destroyed as soon as its wait() returns, so a worker that still touches a
+# finished job shows up here under ThreadSanitizer (-DWORDCOUNT_TSAN=ON).
+# Usage: project1ManyFiles.sh <wordCounter binary>
+set -e
+counter="$1"
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir"
+
+files=""
+for i in $(seq 1 1000); do
+    printf 'alpha beta gamma\nbeta gamma\ngamma\n' > "in_$i.txt"
+    files="$files in_$i.txt"
+done
+"$counter" $files > log.txt
+
+for i in 1 500 1000; do
+    grep -qx "gamma: 3" "output_$i.txt"
+    grep -qx "beta: 2" "output_$i.txt"
+    grep -qx "alpha: 1" "output_$i.txt"
+done